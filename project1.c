@@ -1,12 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
 
-#define INFINITE 100000000
+#define INFINITE UINT32_MAX
 #define TRUE    1
 #define FALSE   0
 #define EMPTY   -1
 #define AND     &&
 
+#define SCALAR          0
+#define SIMD            1
+#define PARALLEL        2
+#define DIAL            3
+#define ASTAR           4
+#define BIDIRECTIONAL   5
+
 /* Nome:  Tiago Trocoli
    Email: tiago1trocoli@gmail.com
 
@@ -14,24 +24,114 @@
 */
 
 
+/* How the program works:
+
+    1) The maze is read from maze.txt: the coordinates of Thomas, the coordinates of the exit, the number of rows and columns
+       and then the grid, where 0 is free and 1 is a wall. There is no limit on the size of the grid.
+       The line of the exit may have several pairs "x y": all the exits start the BFS together, the distances are to the
+       nearest exit and the paths end at any of the nearest exits.
+       A weighted maze starts with the letter W, and then each grid is 0 for a wall or the cost (1 to 255) of walking into it.
+    2) ./project1      prints every shortest path between Thomas and the exit.
+       ./project1 -c   only prints the number of shortest paths, so it can be checked before enumerating them.
+    3) -e scalar (default), -e simd or -e parallel picks the BFS engine: the queue BFS, the bitset BFS or the multi-threaded BFS.
+       Compile with -mavx2 (or -march=native) to let the bitset BFS use AVX2, and with -pthread.
+       The bitset BFS only pays off when the frontiers are wide, as with many exits (900 exits on a 3000x3000 maze: 5 times
+       faster). With one exit the frontier is a thin line and it is about 25% slower than the scalar BFS, so scalar stays
+       the default.
+       -t N sets the number of threads of the parallel BFS (default: one per processor).
+       -e dial or -e astar picks the bucket queue search or A*, which also work for weighted mazes (dial is the default there).
+       -e bidir runs a BFS from Thomas and one from the exit until they meet (mazes without weights).
+       A* and bidir only find the shortest paths of Thomas, so they refuse -q, -s and -u.
+    4) -s field.bin saves the result of the BFS and -l field.bin maps it back instead of reading maze.txt and running the BFS.
+    5) -q queries.txt answers a query for each start grid "x y" of the file: its distance to the exit, its number of shortest
+       paths and, with -k K, its first K shortest paths.
+    6) -r K prints K shortest paths drawn uniformly at random, instead of all of them. -seed S sets the seed of the random numbers.
+    7) -u updates.txt toggles each grid "x y" of the file between free and wall after the BFS (or after -l), repairing only
+       the distances that change.
+    8) -b paths.bin writes the paths in a compact binary file (2 bits per step) instead of printing them, and
+       ./project1 -d paths.bin prints the paths of that file as text.
+    9) -g rooms|perfect|random rows columns uses a generated maze instead of maze.txt (-density D for random, -seed S),
+       -w file writes it in the format of maze.txt and -B prints the time of each step as JSON (see Benchmark).
+*/
+
 /*It was assumed that Thomas only walks left, right, down and up.*/
 
 /* Maze data structure */
 
-int s1, s2; /* Coordinates of the exit. */
+int s1, s2; /* Coordinates of the (first) exit. */
+int numExits;  /* The number of exits. */
+int *exits;    /* The exits, as positions of the vectors (see function). */
 int t1, t2; /* Coordinates of Thomas. */
 int n, m;    /* Number of rows (n) and columns (m). */
 
-/* The maze data structure is a vector of Vertex, in which each of its grid corresponds to a Vertex.*/
-typedef struct{
-    int dist;    /* The shortest distance from the exit.*/
-    int adj[4];  /* The set of adjancent grids, maximum 4 (left,right,up,down).*/
-    int prev[4]; /* The set of predecessors. It is used to find the shortest paths.*/
-}Vertex;
+/*  The maze is an implicit grid: the neighbors of a grid are computed from its position, so no adjacency list is stored.
+    Each grid only keeps its distance (32 bits), one bit in the wall map and a 4 bits mask of predecessors, +/- 4.6 bytes
+    instead of the 36 bytes of a vertex with adjacency and predecessor lists.*/
+
+typedef uint32_t Dist;
+
+Dist          *dist     = NULL;  /* dist[v] = the shortest distance from v to the exit.*/
+unsigned char *prevMask = NULL;  /* Two grids per byte. Bit d of the mask of v is set if the neighbor of v in the direction d is a predecessor.*/
+
+/* The walls are kept in a bit-packed map. Each row takes rowWords words of 64 bits and the column y of the row x is the
+   bit y%64 of wall[x*rowWords + y/64]. The bits after the last column are walls, so they never become a path.*/
+uint64_t *wall = NULL;
+int rowWords;
+
+void createWallMap(){
+
+    int i;
+
+    rowWords = (m + 63) / 64;
+    wall     = (uint64_t*)calloc((size_t)n*rowWords, sizeof(uint64_t));
+
+    if(m % 64 != 0)
+        for(i=0; i < n; i++)
+            wall[(size_t)i*rowWords + rowWords - 1] = ~(uint64_t)0 << (m % 64);
+}
+
+static inline int isWall(int x, int y){
+
+    return (wall[(size_t)x*rowWords + (y >> 6)] >> (y & 63)) & 1;
+}
+
+static inline void setWall(int x, int y){
+
+    wall[(size_t)x*rowWords + (y >> 6)] |= (uint64_t)1 << (y & 63);
+}
+
+static inline void clearWall(int x, int y){
+
+    wall[(size_t)x*rowWords + (y >> 6)] &= ~((uint64_t)1 << (y & 63));
+}
+
+/* Sets of grids with one bit per grid v (onPath, settled and mark below).*/
+static inline int getBit(uint64_t *bits, int v){
+
+    return (bits[v >> 6] >> (v & 63)) & 1;
+}
+
+static inline void setBit(uint64_t *bits, int v){
+
+    bits[v >> 6] |= (uint64_t)1 << (v & 63);
+}
+
+static inline void clearBit(uint64_t *bits, int v){
+
+    bits[v >> 6] &= ~((uint64_t)1 << (v & 63));
+}
+
+/* In a weighted maze, cost[v] is the cost (1 to 255) of walking into the grid v. It is NULL if every step costs 1.*/
+unsigned char *cost   = NULL;
+int           minCost = 1;
+int           maxCost = 1;
 
-Vertex *V;
+static inline int costOf(int v){
 
-/*An one-to-one function that maps the coordinates of the grid to its location on the vector Vertex.*/
+    return cost == NULL ? 1 : cost[v];
+}
+
+/*An one-to-one function that maps the coordinates of the grid to its location on the vectors dist and prevMask.*/
 /*F(row,column) = m*row + column, where m is the number of columns.*/
 int function(int x,int y){
 
@@ -50,47 +150,87 @@ int getY(int value){
     return value % m;
 }
 
-void initializeVertex(){
+int verifyBoundary(int x, int y){
+
+    return  (x > -1 AND x < n) AND (y > -1 AND y < m);
 
-    int i,j;
-    V = (Vertex*)malloc(m*n*sizeof(Vertex));
+}
 
-    for(i = 0; i < n*m; i++){
+/* The four directions. The opposite of the direction d is d^1.*/
+#define DOWN    0
+#define UP      1
+#define RIGHT   2
+#define LEFT    3
 
-        V[i].dist  = INFINITE;
-        for(j=0; j < 4 ;j++){
+int stepX[4] = {1, -1, 0,  0};
+int stepY[4] = {0,  0, 1, -1};
 
-            V[i].prev[j]    = EMPTY;
-            V[i].adj[j]     = EMPTY;
-        }
-    }
+/*Returns the neighbor of v in the direction d, or EMPTY if it is outside the maze or a wall.*/
+static inline int neighbor(int v, int d){
+
+    int x = getX(v) + stepX[d];
+    int y = getY(v) + stepY[d];
+
+    if(!verifyBoundary(x,y) || isWall(x,y))
+        return EMPTY;
+
+    return function(x,y);
+}
+
+static inline int getPrevMask(int v){
+
+    return (prevMask[v >> 1] >> ((v & 1) << 2)) & 15;
+}
+
+/*Put the neighbor of v in the direction d in the set of predecessors of v.*/
+static inline void addPredecessor(int v, int d){
+
+    prevMask[v >> 1] |= (1 << d) << ((v & 1) << 2);
 }
 
-/*Put (x2,y2) in the set of adjacent vertex of (x1,y1)*/
-void addAdj(int x1, int y1, int x2, int y2){
+/*Put every exit that is not a wall at distance 0 and in the list (if it is not NULL). Returns the number of them.*/
+int seedExits(int *list){
+
+    int i, size = 0;
+
+    for(i=0; i < numExits; i++){
+
+        int v = exits[i];
 
-    int i = -1;
+        if(isWall(getX(v), getY(v)) || dist[v] == 0)
+            continue;
 
-    int v1 = function(x1,y1);
-    int v2 = function(x2,y2);
+        dist[v] = 0;
 
-    while(V[v1].adj[++i] != EMPTY);
-    V[v1].adj[i] = v2;
+        if(list != NULL)
+            list[size] = v;
+        size++;
+    }
+
+    return size;
 }
 
-/*Put v1 in the set of predecessors of v2*/
-void addPredecessor(int v1, int v2){
+/*The index of the exit v in exits, or EMPTY if v is not an exit.*/
+int exitIndex(int v){
+
+    int i;
 
-    int i = -1;
+    for(i=0; i < numExits; i++)
+        if(exits[i] == v)
+            return i;
 
-    while(V[v1].prev[++i] != EMPTY);
-    V[v1].prev[i] = v2;
+    return EMPTY;
 }
 
-int verifyBoundary(int x, int y){
+void initializeGraph(){
 
-    return  (x > -1 AND x < n) AND (y > -1 AND y < m);
+    size_t i;
 
+    dist     = (Dist*)malloc((size_t)n*m*sizeof(Dist));
+    prevMask = (unsigned char*)calloc(((size_t)n*m + 1) / 2, sizeof(unsigned char));
+
+    for(i = 0; i < (size_t)n*m; i++)
+        dist[i] = INFINITE;
 }
 
 /**************************************************************************************/
@@ -124,166 +264,2371 @@ int isQueueEmpty(){
 }
 
 /**************************************************************************************/
-/* Stack data structure*/
+/*Breadth First Search*/
+
+/*I use BFS to find all shortest distance from the exit to all grid in order to backtrack the paths in the right order.*/
+/*Require all vertex's distance = INFINITY.*/
+
+void modifiedBFS(){
+
+    int d;
+
+    top       = seedExits(queue) - 1;
+    front     = 0;
+    queueSize = top + 1;
+
+    while(!isQueueEmpty()){
+
+        int v1   = dequeue();
+
+        /*For each edge v1 - v2*/
+        for(d = 0; d < 4; d++){
+
+            int v2 = neighbor(v1,d);
+
+            if(v2 == EMPTY)
+                continue;
+
+            /*If v2.dist = INFINITY, it means v2 ins't discovered yet.*/
+            if(dist[v1] + 1 < dist[v2]){
 
-int *stack;
-int last    = -1;  /*Index to the last element of the stack.*/
-int maxSize = 0;
+                enqueue(v2);
+                dist[v2] = dist[v1] + 1;
+                addPredecessor(v2, d^1);
 
-void createStack(int size){
+            /*If v2 was already discovered.*/
+            }else if(dist[v1] + 1 == dist[v2])
+                addPredecessor(v2, d^1);
+        }
+    }
 
-    maxSize = size;
-    stack   = (int*)malloc(size*sizeof(int));
 }
 
-int removeStack(){
 
-    return stack[last--];
+/**************************************************************************************/
+/*Bitset Breadth First Search*/
+
+/*  The same BFS, level by level, on bitsets. The frontier and the visited set are kept like the wall map, one bit per grid,
+    so a single 64 bits word expands 64 grids at once: the grids reached from the left neighbor are (frontier << 1), from the
+    right neighbor (frontier >> 1) and from the neighbors above and below are the same word of the rows above and below.
+    The new frontier is the union of them AND NOT the visited set (walls are marked as visited).
+
+    Each row of the bitsets has an extra zero word at its end and there is an extra zero row above and below the maze,
+    so the shifts never carry bits from one row to another. Row x, word k is at (x+1)*stride + k.
+
+    When the frontier is sparse, only the words around the words of the frontier are expanded. When it is dense, every
+    word is expanded in a sweep that uses AVX2 (4 words at once) if the program is compiled with it.
+
+    It produces the same dist and prevMask as modifiedBFS.*/
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+uint64_t *frontier, *nextFrontier, *visited;
+int      stride;
+int      *active,  numActive;      /* The words of frontier that are not zero.*/
+int      *nextActive, numNextActive;
+int      *candidate;
+uint32_t *stamp;                   /* stamp[word] = level + 1 if the word is already a candidate of this level.*/
+
+void createBitsets(){
+
+    int    i, k;
+    size_t words;
+
+    stride = rowWords + 1;
+    words  = (size_t)(n + 2)*stride;
+
+    frontier     = (uint64_t*)calloc(words, sizeof(uint64_t));
+    nextFrontier = (uint64_t*)calloc(words, sizeof(uint64_t));
+    visited      = (uint64_t*)malloc(words*sizeof(uint64_t));
+    stamp        = (uint32_t*)calloc(words, sizeof(uint32_t));
+    active       = (int*)malloc(words*sizeof(int));
+    nextActive   = (int*)malloc(words*sizeof(int));
+    candidate    = (int*)malloc(words*sizeof(int));
+
+    /* The extra words and rows are visited, so they never join the frontier.*/
+    memset(visited, 0xFF, words*sizeof(uint64_t));
+
+    for(i=0; i < n; i++)
+        for(k=0; k < rowWords; k++)
+            visited[(size_t)(i+1)*stride + k] = wall[(size_t)i*rowWords + k];
 }
 
-int insertStack(int data){
+void freeBitsets(){
 
-    stack[++last] = data;
+    free(frontier);  free(nextFrontier);  free(visited);  free(stamp);
+    free(active);    free(nextActive);    free(candidate);
 }
 
-int getAtualSize(){
+/*Record the grids of the word idx that joined the frontier of the level "level", with their distance and predecessors.*/
+static inline void recordWord(int idx, uint64_t N, Dist level){
+
+    uint64_t fromLeft  = (frontier[idx] << 1) | (frontier[idx-1] >> 63);
+    uint64_t fromRight = (frontier[idx] >> 1) | (frontier[idx+1] << 63);
+    uint64_t fromUp    = frontier[idx - stride];
+    uint64_t fromDown  = frontier[idx + stride];
+
+    int x  = idx / stride - 1;
+    int y0 = (idx % stride) * 64;
 
-    return last;
+    nextActive[numNextActive++] = idx;
+
+    while(N != 0){
+
+        int b = __builtin_ctzll(N);
+        int v = function(x, y0 + b);
+
+        int mask = (int)((fromLeft >> b) & 1) << LEFT | (int)((fromRight >> b) & 1) << RIGHT
+                 | (int)((fromUp   >> b) & 1) << UP   | (int)((fromDown  >> b) & 1) << DOWN;
+
+        dist[v] = level;
+        prevMask[v >> 1] |= mask << ((v & 1) << 2);
+
+        N &= N - 1;
+    }
 }
 
-int seeDataStack(int index){
+/*The new grids of the word idx.*/
+static inline uint64_t expandWord(int idx){
 
-    return stack[index];
+    uint64_t reach = (frontier[idx] << 1) | (frontier[idx-1] >> 63)
+                   | (frontier[idx] >> 1) | (frontier[idx+1] << 63)
+                   | frontier[idx - stride] | frontier[idx + stride];
+
+    return reach & ~visited[idx];
 }
 
-/**************************************************************************************/
-/*Breadth First Search*/
+/*Expand only the words around the frontier.*/
+void sparseLevel(Dist level){
 
-/*I use BFS to find all shortest distance from the exit to all grid in order to backtrack the paths in the right order.*/
-/*Require all vertex's distance = INFINITY.*/
+    int i, j, numCandidates = 0;
+    int around[5];
 
-void modifiedBFS(){
+    for(i=0; i < numActive; i++){
 
-    int i;
-    int Exit = function(s1,s2);
+        around[0] = active[i];
+        around[1] = active[i] - 1;
+        around[2] = active[i] + 1;
+        around[3] = active[i] - stride;
+        around[4] = active[i] + stride;
 
-    V[Exit].dist = 0;
-    enqueue(Exit);
+        for(j=0; j < 5; j++){
 
-    while(!isQueueEmpty()){
+            int idx = around[j];
 
-        int v1   = dequeue();
+            if(stamp[idx] != level AND visited[idx] != ~(uint64_t)0){
 
-        /*For each edge v1 - v2*/
-        for( i = 0 ; (V[v1].adj[i] != EMPTY) ; i++) {
+                stamp[idx] = level;
+                candidate[numCandidates++] = idx;
+            }
+        }
+    }
 
-            int v2 = V[v1].adj[i];
+    /*All the new words are found before visited changes, because the predecessors only depend on frontier.*/
+    for(i=0; i < numCandidates; i++)
+        nextFrontier[candidate[i]] = expandWord(candidate[i]);
 
-            /*If v2.dist = INFINITY, it means v2 ins't discovered yet.*/
-            if(V[v1].dist + 1 < V[v2].dist){
+    for(i=0; i < numCandidates; i++){
 
-                enqueue(v2);
-                V[v2].dist = V[v1].dist + 1;
-                addPredecessor(v2,v1);
+        int idx = candidate[i];
 
-            /*If v2 was already discovered.*/
-            }else if(V[v1].dist + 1 == V[v2].dist)
-                addPredecessor(v2,v1);
+        if(nextFrontier[idx] != 0){
+
+            visited[idx] |= nextFrontier[idx];
+            recordWord(idx, nextFrontier[idx], level);
         }
     }
-
 }
 
+/*Expand every word of the maze.*/
+void denseLevel(Dist level){
 
-/**************************************************************************************/
+    int x, k;
 
-int pathExist = FALSE;
+    for(x=0; x < n; x++){
+
+        int row = (x+1)*stride;
+
+        k = 0;
 
-void printPath(){
+#ifdef __AVX2__
+        for(; k + 4 <= rowWords; k += 4){
 
-    int i = -1;
+            int idx = row + k;
 
-    while(++i <= getAtualSize()){
+            __m256i f     = _mm256_loadu_si256((__m256i*)&frontier[idx]);
+            __m256i left  = _mm256_loadu_si256((__m256i*)&frontier[idx-1]);
+            __m256i right = _mm256_loadu_si256((__m256i*)&frontier[idx+1]);
+            __m256i up    = _mm256_loadu_si256((__m256i*)&frontier[idx-stride]);
+            __m256i down  = _mm256_loadu_si256((__m256i*)&frontier[idx+stride]);
+            __m256i vis   = _mm256_loadu_si256((__m256i*)&visited[idx]);
 
-        int v = seeDataStack(i);
-        printf("(%d,%d) ", getX(v), getY(v));
+            __m256i reach = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi64(f,1), _mm256_srli_epi64(left,63)),
+                                            _mm256_or_si256(_mm256_srli_epi64(f,1), _mm256_slli_epi64(right,63)));
+
+            reach = _mm256_or_si256(reach, _mm256_or_si256(up, down));
+            _mm256_storeu_si256((__m256i*)&nextFrontier[idx], _mm256_andnot_si256(vis, reach));
+        }
+#endif
+        for(; k < rowWords; k++)
+            nextFrontier[row + k] = expandWord(row + k);
     }
 
-    printf("\n");
-    pathExist = TRUE;
+    for(x=0; x < n; x++){
+
+        int row = (x+1)*stride;
+
+        for(k=0; k < rowWords; k++){
+
+            int idx = row + k;
+
+            if(nextFrontier[idx] != 0){
+
+                visited[idx] |= nextFrontier[idx];
+                recordWord(idx, nextFrontier[idx], level);
+            }
+        }
+    }
 }
 
-/*Recursive function that uses the set of predecessors to walk on the path.*/
-int printAllPaths(int v){
+/*Require all vertex's distance = INFINITY.*/
+void bitsetBFS(){
 
-    int i;
+    int      i;
+    int      *swapInt;
+    uint64_t *swapWord;
+    Dist     level;
+    int      totalWords = n*rowWords;
+
+    createBitsets();
+
+    numActive = 0;
+
+    for(i=0; i < numExits; i++){
+
+        int x   = getX(exits[i]);
+        int y   = getY(exits[i]);
+        int idx = (x+1)*stride + (y >> 6);
+
+        if(isWall(x,y))
+            continue;
+
+        if(frontier[idx] == 0)
+            active[numActive++] = idx;
 
-    insertStack(v);
+        dist[exits[i]]  = 0;
+        frontier[idx]  |= (uint64_t)1 << (y & 63);
+        visited[idx]   |= frontier[idx];
+    }
+
+    for(level = 1; numActive > 0; level++){
+
+        numNextActive = 0;
+
+        if(numActive > totalWords / 16)
+            denseLevel(level);
+        else
+            sparseLevel(level);
 
-    for(i=0; (V[v].prev[i] != EMPTY) ; i++)
-        printAllPaths(V[v].prev[i]);
+        /*The old frontier becomes the next one, so it must be zero again.*/
+        for(i=0; i < numActive; i++)
+            frontier[active[i]] = 0;
 
-    /*Whenever a function reach its destination, it prints a path.*/
-    if(s1 == getX(v) AND s2 == getY(v))
-        printPath();
+        swapWord = frontier;  frontier = nextFrontier;  nextFrontier = swapWord;
+        swapInt  = active;    active   = nextActive;    nextActive   = swapInt;
+        numActive = numNextActive;
+    }
 
-    removeStack();
+    freeBitsets();
 }
 
 /**************************************************************************************/
+/*Parallel Breadth First Search*/
 
-void readFile(char *fileName){
+/*  The same BFS, level by level, with numThreads threads. The grids of each level are kept in queue, between levelStart and
+    levelEnd, and each thread expands its own part of the level:
 
-    FILE* fp;
-    int i, j;
-    int maze[100][100];
+    1) A thread discovers a grid by changing its distance from INFINITE to level + 1 with an atomic compare and swap, so each
+       new grid is discovered by a single thread, which keeps it in its own buffer.
+    2) The buffers are copied after levelEnd, each one at the position given by the sizes of the buffers before it.
+    3) Each thread computes the predecessors of its part of the new grids: the neighbors with distance = level. Two grids share
+       a byte of prevMask, so the mask is written with an atomic OR.
+
+    The distances and the sets of predecessors are the same as in modifiedBFS.*/
 
-    fp = fopen(fileName, "r");
+#include <pthread.h>
+#include <unistd.h>
 
-    /* Read the coordinates of Thomas. */
-    fscanf(fp,"%d %d\n", &t1,&t2);
+int numThreads = 0;         /* 0 means one thread per processor.*/
+int numSources;             /* The number of grids of the level 0 (the exits).*/
 
-    /* Read the coordinates of the exit. */
-    fscanf(fp,"%d %d\n", &s1,&s2);
+typedef struct{
+    int id;
+    int *buffer;            /* The grids discovered by this thread in the current level.*/
+    int size;
+    int capacity;
+}Worker;
 
-    /* Read the number of rows (n) and columns (m). */
-    fscanf(fp,"%d %d\n", &n,&m);
+Worker            *worker;
+pthread_barrier_t barrier;
 
-    /* Read the maze. */
-    for (i=0; i < n; i++){
-        for(j=0; j < m; j++)
-            fscanf(fp,"%d", &maze[i][j]);
-     }
+void pushWorker(Worker *w, int v){
 
-    initializeVertex();
+    if(w->size == w->capacity){
 
-    for (i=0; i < n; i++){
-        for(j=0; j < m; j++){
-            if(maze[i][j] == 0){
-                if(maze[i+1][j] == 0 AND verifyBoundary(i+1,j))
-                    addAdj(i,j,i+1,j);
-                if(maze[i-1][j] == 0 AND verifyBoundary(i-1,j))
-                    addAdj(i,j,i-1,j);
-                if(maze[i][j+1] == 0 AND verifyBoundary(i,j+1))
-                    addAdj(i,j,i,j+1);
-                if(maze[i][j-1] == 0 AND verifyBoundary(i,j-1))
-                    addAdj(i,j,i,j-1);
+        w->capacity = 2*w->capacity + 64;
+        w->buffer   = (int*)realloc(w->buffer, w->capacity*sizeof(int));
+    }
+
+    w->buffer[w->size++] = v;
+}
+
+void *parallelLevels(void *arg){
+
+    Worker *w        = (Worker*)arg;
+    int    levelStart = 0;
+    int    levelEnd   = numSources;
+    Dist   level      = 0;
+    int    i, d;
+
+    while(levelEnd > levelStart){
+
+        int len   = levelEnd - levelStart;
+        int begin = levelStart + (int)((int64_t)len*w->id/numThreads);
+        int end   = levelStart + (int)((int64_t)len*(w->id+1)/numThreads);
+        int offset = 0, total = 0;
+
+        /* 1) Discover the grids of the next level.*/
+        w->size = 0;
+
+        for(i=begin; i < end; i++){
+
+            int v1 = queue[i];
+
+            for(d=0; d < 4; d++){
+
+                int  v2       = neighbor(v1,d);
+                Dist infinite = INFINITE;
+
+                if(v2 != EMPTY AND __atomic_load_n(&dist[v2], __ATOMIC_RELAXED) == INFINITE
+                   AND __atomic_compare_exchange_n(&dist[v2], &infinite, level + 1, FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    pushWorker(w, v2);
+            }
+        }
+
+        pthread_barrier_wait(&barrier);
+
+        /* 2) Copy the buffers to the queue.*/
+        for(i=0; i < numThreads; i++){
+
+            if(i < w->id)
+                offset += worker[i].size;
+            total += worker[i].size;
+        }
+
+        if(w->size > 0)
+            memcpy(&queue[levelEnd + offset], w->buffer, w->size*sizeof(int));
+
+        pthread_barrier_wait(&barrier);
+
+        /* 3) Predecessors of the new grids.*/
+        begin = levelEnd + (int)((int64_t)total*w->id/numThreads);
+        end   = levelEnd + (int)((int64_t)total*(w->id+1)/numThreads);
+
+        for(i=begin; i < end; i++){
+
+            int v    = queue[i];
+            int mask = 0;
+
+            for(d=0; d < 4; d++){
+
+                int u = neighbor(v,d);
+
+                if(u != EMPTY AND dist[u] == level)
+                    mask |= 1 << d;
             }
+
+            __atomic_fetch_or(&prevMask[v >> 1], (unsigned char)(mask << ((v & 1) << 2)), __ATOMIC_RELAXED);
         }
+
+        pthread_barrier_wait(&barrier);
+
+        levelStart = levelEnd;
+        levelEnd  += total;
+        level++;
     }
+
+    return NULL;
 }
 
-int main(){
+/*Require all vertex's distance = INFINITY.*/
+void parallelBFS(){
+
+    int       i;
+    pthread_t *thread;
+
+    if(numThreads <= 0)
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
 
-    readFile("maze.txt");
+    if(numThreads <= 0)
+        numThreads = 1;
 
     createQueue(m*n);
 
-    modifiedBFS();
+    numSources = seedExits(queue);
+
+    if(numSources == 0)
+        return;
+
+    worker = (Worker*)calloc(numThreads, sizeof(Worker));
+    thread = (pthread_t*)malloc(numThreads*sizeof(pthread_t));
+
+    pthread_barrier_init(&barrier, NULL, numThreads);
+
+    for(i=0; i < numThreads; i++){
+
+        worker[i].id = i;
+        pthread_create(&thread[i], NULL, parallelLevels, &worker[i]);
+    }
+
+    for(i=0; i < numThreads; i++){
+
+        pthread_join(thread[i], NULL);
+        free(worker[i].buffer);
+    }
+
+    pthread_barrier_destroy(&barrier);
+    free(worker);
+    free(thread);
+}
+
+/**************************************************************************************/
+/*Bidirectional Breadth First Search*/
+
+/*  When only Thomas matters, two BFS are run, one from the exit (side 0, in dist) and one from Thomas (side 1, in distThomas),
+    one level at a time, always expanding the side with the smaller frontier. The first level in which a side discovers a
+    grid already visited by the other side gives the shortest distance D = d0 + d1, and the grids of that level with
+    d0 + d1 = D are the meeting layer: every shortest path passes through one of them.
+
+    Then the grids of the shortest paths are found by walking back from the meeting layer on both sides (to the neighbors
+    one level closer to the start of each side), their distance to the exit is D - d1 on the side of Thomas, and the
+    predecessors of each of them are its neighbors on the shortest paths that are one step closer to the exit.
+
+    Only the grids around the two starts are visited, so on a large maze with near endpoints it touches a small part of it.
+    Only the grids of the shortest paths of Thomas get predecessors, so it is not meant for -q.*/
+
+Dist     *distThomas;       /* distThomas[v] = distance from Thomas + 1, 0 if it was not visited (calloc).*/
+uint64_t *onPath;           /* One bit per grid of a shortest path.*/
+
+static inline Dist sideDist(int side, int v){
+
+    return side == 0 ? dist[v] : distThomas[v] - 1;
+}
+
+static inline void setSideDist(int side, int v, Dist value){
+
+    if(side == 0)
+        dist[v] = value;
+    else
+        distThomas[v] = value + 1;
+}
+
+/*Mark v as a grid of a shortest path and put it in the list, if it is not already marked.*/
+static inline void markOnPath(int v, int *list, int *size){
+
+    if(!getBit(onPath, v)){
+
+        setBit(onPath, v);
+        list[(*size)++] = v;
+    }
+}
+
+void bidirectionalBFS(){
+
+    int  *level[2];             /* The grids of the current level of each side, and the next level after them.*/
+    int  begin[2], end[2];
+    int  i, d, side, size = 0;
+    int  *path, numMeeting = 0;     /* The grids of the shortest paths, starting with the meeting layer.*/
+    Dist best   = INFINITE;
+    int  Thomas = function(t1,t2);
+
+    if(isWall(t1,t2))
+        return;
+
+    if(exitIndex(Thomas) != EMPTY){
+
+        dist[Thomas] = 0;
+        return;
+    }
+
+    distThomas = (Dist*)calloc((size_t)n*m, sizeof(Dist));
+    onPath     = (uint64_t*)calloc(((size_t)n*m + 63) / 64, sizeof(uint64_t));
+    level[0]   = (int*)malloc((size_t)n*m*sizeof(int));
+    level[1]   = (int*)malloc((size_t)n*m*sizeof(int));
+    path       = (int*)malloc((size_t)n*m*sizeof(int));
+
+    setSideDist(1, Thomas, 0);
+    end[0]      = seedExits(level[0]);  begin[0] = 0;
+    level[1][0] = Thomas;               begin[1] = 0;  end[1] = 1;
+
+    while(best == INFINITE AND end[0] > begin[0] AND end[1] > begin[1]){
+
+        int last;
+
+        side = (end[0] - begin[0] <= end[1] - begin[1]) ? 0 : 1;
+        last = end[side];
+
+        for(i=begin[side]; i < end[side]; i++){
+
+            int  v     = level[side][i];
+            Dist distV = sideDist(side, v);
+
+            for(d=0; d < 4; d++){
+
+                int w = neighbor(v,d);
+
+                if(w == EMPTY || sideDist(side, w) != INFINITE)
+                    continue;
+
+                setSideDist(side, w, distV + 1);
+                level[side][last++] = w;
+
+                /*The other side already visited w: the two searches met.*/
+                if(sideDist(1 - side, w) != INFINITE){
+
+                    Dist length = distV + 1 + sideDist(1 - side, w);
+
+                    if(length < best){
+
+                        best       = length;
+                        numMeeting = 0;
+                    }
+
+                    if(length == best)
+                        path[numMeeting++] = w;
+                }
+            }
+        }
+
+        begin[side] = end[side];
+        end[side]   = last;
+    }
+
+    /*Walk back from the meeting layer on both sides.*/
+    for(i=0; i < numMeeting; i++)
+        markOnPath(path[i], path, &size);
+
+    for(i=0; i < size; i++){
+
+        int v = path[i];
+
+        for(side=0; side < 2; side++){
+
+            Dist distV = sideDist(side, v);
+
+            if(distV == INFINITE || distV == 0)
+                continue;
+
+            for(d=0; d < 4; d++){
+
+                int w = neighbor(v,d);
+
+                if(w != EMPTY AND sideDist(side, w) == distV - 1)
+                    markOnPath(w, path, &size);
+            }
+        }
+    }
 
-    createStack(m*n);
+    /*Distances to the exit and predecessors of the grids of the shortest paths.*/
+    for(i=0; i < size; i++)
+        if(dist[path[i]] == INFINITE)
+            dist[path[i]] = best - sideDist(1, path[i]);
+
+    for(i=0; i < size; i++){
+
+        int v = path[i];
+
+        for(d=0; d < 4; d++){
+
+            int w = neighbor(v,d);
+
+            if(w != EMPTY AND getBit(onPath, w) AND dist[w] + 1 == dist[v])
+                addPredecessor(v,d);
+        }
+    }
+
+    free(distThomas);
+    free(onPath);
+    free(level[0]);
+    free(level[1]);
+    free(path);
+}
+
+/**************************************************************************************/
+/*Weighted search*/
+
+/*  In a weighted maze, walking into a grid v costs cost[v] (1 to 255) and dist[v] is the cheapest cost from v to the exit.
+    The search starts at the exit, and from a grid v the cost to reach its neighbor w is dist[v] + cost[v].
+
+    The grids waiting to be settled are kept in a bucket queue (Dial's algorithm): the bucket k holds the grids of key k, and
+    since the costs are small integers, the keys waiting at any time are between the current key and current key + 2*maxCost,
+    so a ring of 2*maxCost + 1 buckets is enough and each grid is pushed and popped in constant time.
+
+    1) Dial:  the key is dist, so all the grids are settled in order of distance, like the BFS.
+    2) A*:    the key is dist + minCost * (Manhattan distance to Thomas). It never overestimates the cost to Thomas and it
+              changes by at most the cost of a step, so every grid is settled with its exact distance. The search stops
+              after the last key that is not greater than dist[Thomas]: all the grids of the shortest paths of Thomas have
+              keys that are not greater than that, so they are all settled, and much of the maze is not.
+
+    The settled grids are kept in queue in the order they were settled. In the end, the predecessors of a settled grid w are
+    its settled neighbors v with dist[v] + cost[v] = dist[w], the same set of predecessors as in the BFS.*/
+
+typedef struct{
+    int *item;
+    int size;
+    int capacity;
+}Bucket;
+
+Bucket   *bucket;
+int      numBuckets;
+uint64_t *settled;          /* One bit per grid.*/
+
+void appendList(Bucket *b, int v){
+
+    if(b->size == b->capacity){
+
+        b->capacity = 2*b->capacity + 16;
+        b->item     = (int*)realloc(b->item, b->capacity*sizeof(int));
+    }
+
+    b->item[b->size++] = v;
+}
+
+void pushBucket(uint64_t key, int v){
+
+    appendList(&bucket[key % numBuckets], v);
+}
+
+/*The estimate of the cost from v to Thomas used by A*.*/
+static inline uint64_t heuristic(int v){
+
+    return (uint64_t)minCost * (abs(getX(v) - t1) + abs(getY(v) - t2));
+}
+
+void weightedPredecessors(){
+
+    int i, d;
+
+    for(i=0; i <= top; i++){
+
+        int w = queue[i];
+
+        for(d=0; d < 4; d++){
+
+            int v = neighbor(w,d);
+
+            if(v != EMPTY AND getBit(settled, v) AND dist[v] + costOf(v) == dist[w])
+                addPredecessor(w,d);
+        }
+    }
+}
+
+/*Require all vertex's distance = INFINITY.*/
+void bucketSearch(int astar){
+
+    int      i, d;
+    int      Thomas  = function(t1,t2);
+    int      *source = (int*)malloc((numExits + 1)*sizeof(int));
+    long     pending = seedExits(source);
+    uint64_t key     = UINT64_MAX, lastKey = 0;
+
+    createQueue(m*n);
+
+    /*With A*, the exits start with different keys, so the ring also covers the distance between them.*/
+    for(i=0; i < pending; i++){
+
+        uint64_t k = astar ? heuristic(source[i]) : 0;
+
+        if(k < key)     key     = k;
+        if(k > lastKey) lastKey = k;
+    }
+
+    numBuckets = 2*maxCost + 1 + (pending > 0 ? (int)(lastKey - key) : 0);
+    bucket     = (Bucket*)calloc(numBuckets, sizeof(Bucket));
+    settled    = (uint64_t*)calloc(((size_t)n*m + 63) / 64, sizeof(uint64_t));
+
+    for(i=0; i < pending; i++)
+        pushBucket(astar ? heuristic(source[i]) : 0, source[i]);
+
+    free(source);
+
+    for(; pending > 0; key++){
+
+        Bucket *b = &bucket[key % numBuckets];
+
+        if(astar AND getBit(settled, Thomas) AND key > dist[Thomas])
+            break;
+
+        while(b->size > 0){
+
+            int v = b->item[--b->size];
+
+            --pending;
+
+            /*A grid may be pushed again with a smaller distance, the old copies are skipped.*/
+            if(getBit(settled, v) || dist[v] + (astar ? heuristic(v) : 0) != key)
+                continue;
+
+            setBit(settled, v);
+            enqueue(v);
+
+            for(d=0; d < 4; d++){
+
+                int      w = neighbor(v,d);
+                uint64_t newDist;
+
+                if(w == EMPTY || getBit(settled, w))
+                    continue;
+
+                newDist = (uint64_t)dist[v] + costOf(v);
+
+                if(newDist >= INFINITE){
+
+                    printf("The distances of this maze do not fit in 32 bits.\n");
+                    exit(1);
+                }
+
+                if(newDist < dist[w]){
+
+                    dist[w] = (Dist)newDist;
+                    pushBucket(newDist + (astar ? heuristic(w) : 0), w);
+                    ++pending;
+                }
+            }
+        }
+    }
+
+    /*The grids that A* reached but did not settle do not have their exact distance.*/
+    for(i=0; i < numBuckets; i++){
+
+        while(bucket[i].size > 0){
+
+            int v = bucket[i].item[--bucket[i].size];
+
+            if(!getBit(settled, v))
+                dist[v] = INFINITE;
+        }
+
+        free(bucket[i].item);
+    }
+
+    weightedPredecessors();
+
+    free(bucket);
+    free(settled);
+}
+
+/**************************************************************************************/
+/* Path iterator*/
+
+/*  The shortest paths from a grid are the paths that follow the sets of predecessors until the exit. The iterator walks them
+    in depth first order with an explicit stack, one path per call of nextPath, so it never recurses and it can stop after
+    any number of paths.
+
+    Example:
+        PathIterator it;
+        int *path = malloc(maxPathLength(v)*sizeof(int));
+
+        startPaths(&it, v, 10);
+        while((len = nextPath(&it, path)) > 0)
+            ... path[0] = v, ..., path[len-1] = the exit ...
+        freePaths(&it);
+*/
+
+typedef struct{
+    int  *cell;     /* cell[0..depth] is the current path.*/
+    char *next;     /* next[i] is the next direction to try from cell[i].*/
+    int  depth;     /* -1 when there are no more paths.*/
+    long produced;
+    long limit;     /* The maximum number of paths, -1 for all of them.*/
+}PathIterator;
+
+/*The exits are the only grids at distance 0.*/
+static inline int isExit(int v){
+
+    return dist[v] == 0;
+}
+
+/*The number of grids of a shortest path from v, at most. The buffer given to nextPath must have this size.*/
+int maxPathLength(int v){
+
+    return dist[v] == INFINITE ? 0 : (int)(dist[v] / minCost) + 1;
+}
+
+void startPaths(PathIterator *it, int v, long limit){
+
+    int size = maxPathLength(v) > 0 ? maxPathLength(v) : 1;
+
+    it->cell     = (int*)malloc(size*sizeof(int));
+    it->next     = (char*)malloc(size*sizeof(char));
+    it->cell[0]  = v;
+    it->next[0]  = 0;
+    it->depth    = 0;
+    it->produced = 0;
+    it->limit    = limit;
+}
+
+void freePaths(PathIterator *it){
+
+    free(it->cell);
+    free(it->next);
+}
+
+/*Copy the next shortest path into path and return its number of grids, or 0 if there are no more paths.*/
+int nextPath(PathIterator *it, int *path){
+
+    if(it->limit >= 0 AND it->produced >= it->limit)
+        return 0;
+
+    while(it->depth >= 0){
+
+        int u    = it->cell[it->depth];
+        int d    = it->next[it->depth];
+        int mask = getPrevMask(u);
+
+        /*The exit ends a path. It is given once, then the walk goes back.*/
+        if(d == 0 AND isExit(u)){
+
+            it->next[it->depth] = 4;
+            memcpy(path, it->cell, (it->depth + 1)*sizeof(int));
+            it->produced++;
+
+            return it->depth + 1;
+        }
+
+        while(d < 4 AND !(mask & (1 << d)))
+            d++;
+
+        if(d < 4){
+
+            it->next[it->depth] = d + 1;
+            it->depth++;
+            it->cell[it->depth] = neighbor(u,d);
+            it->next[it->depth] = 0;
+        }else
+            it->depth--;
+    }
+
+    return 0;
+}
+
+/**************************************************************************************/
+/* Binary paths*/
+
+/*  With -b, the paths are written in binary instead of text. Each step of a path goes to one of the 4 neighbors, so it is
+    written as its direction in 2 bits, 32 steps per 64 bits word, instead of "(x,y) " for every grid.
+
+    The file is a PathHeader followed by the paths. Each path is a word with the start grid in the 32 high bits and the
+    number of steps in the 32 low bits, followed by the words of its steps (the first step in the lowest bits).
+    The words go through a large buffer, so there is one fwrite for each OUT_WORDS words.
+    ./project1 -d paths.bin prints the paths of a binary file as text.*/
+
+#define PATH_MAGIC  0x31504250  /* "PBP1" */
+#define OUT_WORDS   (1 << 20)
+
+typedef struct{
+    uint32_t magic;
+    int32_t  n, m;
+    int32_t  unused;
+}PathHeader;
+
+FILE     *binaryOut = NULL;
+uint64_t *outWords;
+size_t   outCount   = 0;
+
+void flushWords(){
+
+    fwrite(outWords, sizeof(uint64_t), outCount, binaryOut);
+    outCount = 0;
+}
+
+static inline void putWord(uint64_t word){
+
+    if(outCount == OUT_WORDS)
+        flushWords();
+
+    outWords[outCount++] = word;
+}
+
+void openBinaryOutput(char *fileName){
+
+    PathHeader h;
+
+    binaryOut = fopen(fileName, "wb");
+
+    if(binaryOut == NULL){
+
+        printf("Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    memset(&h, 0, sizeof(PathHeader));
+    h.magic = PATH_MAGIC;
+    h.n     = n;
+    h.m     = m;
+
+    fwrite(&h, sizeof(PathHeader), 1, binaryOut);
+    outWords = (uint64_t*)malloc(OUT_WORDS*sizeof(uint64_t));
+}
+
+void closeBinaryOutput(){
+
+    flushWords();
+    fclose(binaryOut);
+    free(outWords);
+    binaryOut = NULL;
+}
+
+/*The direction of the step from the grid a to its neighbor b.*/
+static inline uint64_t directionOf(int a, int b){
+
+    if(b - a == m)  return DOWN;
+    if(a - b == m)  return UP;
+    if(b - a == 1)  return RIGHT;
+
+    return LEFT;
+}
+
+void writePathBinary(int *path, int length){
+
+    int      i, bits = 0;
+    uint64_t word    = 0;
+
+    putWord(((uint64_t)(uint32_t)path[0] << 32) | (uint32_t)(length - 1));
+
+    for(i=1; i < length; i++){
+
+        word |= directionOf(path[i-1], path[i]) << bits;
+        bits += 2;
+
+        if(bits == 64){
+
+            putWord(word);
+            word = 0;
+            bits = 0;
+        }
+    }
+
+    if(bits > 0)
+        putWord(word);
+}
+
+/*Print the paths of a binary file as text.*/
+void decodePaths(char *fileName){
+
+    PathHeader h;
+    uint64_t   head, word = 0;
+    FILE       *fp = fopen(fileName, "rb");
+
+    if(fp == NULL || fread(&h, sizeof(PathHeader), 1, fp) != 1 || h.magic != PATH_MAGIC){
+
+        printf("Invalid path file: %s\n", fileName);
+        exit(1);
+    }
+
+    m = h.m;
+
+    while(fread(&head, sizeof(uint64_t), 1, fp) == 1){
+
+        int      x     = getX((int)(head >> 32));
+        int      y     = getY((int)(head >> 32));
+        uint32_t steps = (uint32_t)head, i;
+
+        printf("(%d,%d) ", x, y);
+
+        for(i=0; i < steps; i++){
+
+            int d;
+
+            if(i % 32 == 0 AND fread(&word, sizeof(uint64_t), 1, fp) != 1){
+
+                printf("\nInvalid path file: %s\n", fileName);
+                exit(1);
+            }
+
+            d  = (int)(word >> (2*(i % 32))) & 3;
+            x += stepX[d];
+            y += stepY[d];
+
+            printf("(%d,%d) ", x, y);
+        }
+
+        printf("\n");
+    }
+
+    fclose(fp);
+}
+
+/**************************************************************************************/
+
+int pathExist = FALSE;
+
+void printPath(int *path, int length){
+
+    int i;
+
+    pathExist = TRUE;
+
+    if(binaryOut != NULL){
+
+        writePathBinary(path, length);
+        return;
+    }
+
+    for(i=0; i < length; i++)
+        printf("(%d,%d) ", getX(path[i]), getY(path[i]));
+
+    printf("\n");
+}
+
+/*Print the first limit shortest paths from v (all of them if limit = -1).*/
+void printAllPaths(int v, long limit){
+
+    PathIterator it;
+    int          length;
+    int          *path = (int*)malloc((maxPathLength(v) + 1)*sizeof(int));
+
+    startPaths(&it, v, limit);
+
+    while((length = nextPath(&it, path)) > 0)
+        printPath(path, length);
+
+    freePaths(&it);
+    free(path);
+}
+
+/**************************************************************************************/
+/* Counting the shortest paths*/
+
+/*  The number of shortest paths from v to the exit is the sum of the numbers of shortest paths of its predecessors,
+    and it is 1 for the exit itself. So each vertex is counted only once, instead of walking every path.
+    The counters have 128 bits. If a number does not fit, it saturates at COUNT_MAX and countOverflow is set.*/
+
+typedef unsigned __int128 Count;
+
+#define COUNT_MAX   ((Count) -1)
+#define NEW         0
+#define DONE        1
+
+Count *count        = NULL;   /* count[v] = number of shortest paths from v to the exit.*/
+char  *countState   = NULL;   /* NEW or DONE. The predecessors are closer to the exit, so there are no cycles.*/
+int   *countFrame   = NULL;   /* The stack of the depth first search, kept between the queries.*/
+char  *countNext    = NULL;   /* countNext[i] = next predecessor to try of countFrame[i].*/
+int   countOverflow = FALSE;
+
+Count addCount(Count a, Count b){
+
+    if(a > COUNT_MAX - b){
+
+        countOverflow = TRUE;
+        return COUNT_MAX;
+    }
+
+    return a + b;
+}
+
+/*Non recursive depth first search on the set of predecessors. A vertex is summed up after all its predecessors are counted.*/
+Count countPaths(int v){
+
+    int  i, sp = 0;
+    int  *frame;
+    char *next;
+
+    if(count == NULL){
+
+        count      = (Count*)malloc((size_t)n*m*sizeof(Count));
+        countState = (char*)calloc((size_t)n*m, sizeof(char));
+        countFrame = (int*)malloc((size_t)n*m*sizeof(int));
+        countNext  = (char*)malloc((size_t)n*m*sizeof(char));
+    }
+
+    if(countState[v] == DONE)
+        return count[v];
+
+    frame = countFrame;
+    next  = countNext;
+
+    frame[0] = v;
+    next[0]  = 0;
+
+    while(sp >= 0){
+
+        int u = frame[sp];
+        i     = next[sp];
+
+        int mask = getPrevMask(u);
+
+        /*Go down to the next predecessor that is not counted yet.*/
+        while(i < 4 AND (!(mask & (1 << i)) || countState[neighbor(u,i)] == DONE))
+            i++;
+
+        if(i < 4){
+
+            int p = neighbor(u,i);
+
+            next[sp]    = i + 1;
+            frame[++sp] = p;
+            next[sp]    = 0;
+            continue;
+        }
+
+        /*All predecessors are counted.*/
+        count[u] = isExit(u) ? 1 : 0;
+
+        for(i=0; i < 4; i++)
+            if(mask & (1 << i))
+                count[u] = addCount(count[u], count[neighbor(u,i)]);
+
+        countState[u] = DONE;
+        --sp;
+    }
+
+    return count[v];
+}
+
+/*Print a 128 bits number in decimal.*/
+void printCount(Count c){
+
+    char digits[40];
+    int  i = 0;
+
+    do{
+        digits[i++] = '0' + (int)(c % 10);
+        c /= 10;
+    }while(c != 0);
+
+    while(i > 0)
+        putchar(digits[--i]);
+}
+
+/**************************************************************************************/
+/* Nearest exit*/
+
+/*  With several exits, all of them start at distance 0 in the same BFS, so dist is the distance to the nearest exit and the
+    shortest paths of a grid end at its nearest exits. Following the first predecessor of each grid gives one of them, and
+    every grid of the walk has the same nearest exit, so the walk labels them all: labeling every grid costs O(n*m).*/
+
+#define UNKNOWN -2
+
+int    *exitOf = NULL;      /* exitOf[v] = index of the nearest exit of v (in exits), EMPTY if there is none.*/
+Bucket chain;
+
+int nearestExit(int v){
+
+    int    i, label;
+    size_t k;
+
+    if(exitOf == NULL){
+
+        exitOf = (int*)malloc((size_t)n*m*sizeof(int));
+
+        for(k=0; k < (size_t)n*m; k++)
+            exitOf[k] = UNKNOWN;
+    }
+
+    chain.size = 0;
+
+    while(exitOf[v] == UNKNOWN){
+
+        if(isExit(v))
+            exitOf[v] = exitIndex(v);
+        else if(dist[v] == INFINITE || getPrevMask(v) == 0)
+            exitOf[v] = EMPTY;
+        else{
+
+            appendList(&chain, v);
+            v = neighbor(v, __builtin_ctz(getPrevMask(v)));
+        }
+    }
+
+    label = exitOf[v];
+
+    for(i=0; i < chain.size; i++)
+        exitOf[chain.item[i]] = label;
+
+    return label;
+}
+
+/**************************************************************************************/
+/* Random shortest paths*/
+
+/*  A shortest path from v is drawn uniformly at random by walking from v to the exit and, at each grid u, going to the
+    predecessor p with probability count[p]/count[u]. The probability of a whole path is then the product
+    count[p1]/count[v] * count[p2]/count[p1] * ... = 1/count[v], the same for every path, and each sample costs only the
+    length of the path (after the counts are computed once).
+
+    The random numbers come from splitmix64, so the same seed gives the same paths.*/
+
+uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+void seedRandom(uint64_t seed){
+
+    randomState = seed;
+}
+
+uint64_t nextRandom(){
+
+    uint64_t z = (randomState += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+/*An uniform number in [0, bound). The numbers below 2^128 mod bound are rejected, so no value is more likely than another.*/
+Count randomBelow(Count bound){
+
+    Count threshold = (-bound) % bound;
+    Count r;
+
+    do{
+        r = ((Count) nextRandom() << 64) | nextRandom();
+    }while(r < threshold);
+
+    return r % bound;
+}
+
+/*Write a random shortest path from v into path and return its number of grids, or 0 if v has no path or if the number
+  of paths does not fit in 128 bits (then the probabilities are not exact).*/
+int samplePath(int v, int *path){
+
+    int length = 0;
+
+    if(countPaths(v) == 0 || countOverflow)
+        return 0;
+
+    path[length++] = v;
+
+    while(!isExit(v)){
+
+        int   d;
+        int   mask = getPrevMask(v);
+        Count r    = randomBelow(count[v]);
+
+        for(d=0; d < 4; d++){
+
+            if(mask & (1 << d)){
+
+                int p = neighbor(v,d);
+
+                if(r < count[p]){
+
+                    v = p;
+                    break;
+                }
+
+                r -= count[p];
+            }
+        }
+
+        path[length++] = v;
+    }
+
+    return length;
+}
+
+/**************************************************************************************/
+
+/* Streaming reader*/
+
+/*  The file is read in large blocks and the numbers are parsed by hand, so the load time is limited by the disk and not by fscanf.*/
+
+#define BLOCK_SIZE  (1 << 22)
+
+FILE   *input;
+char   *block;
+size_t blockLen = 0;
+size_t blockPos = 0;
+
+static inline int nextChar(){
+
+    if(blockPos == blockLen){
+
+        blockLen = fread(block, 1, BLOCK_SIZE, input);
+        blockPos = 0;
+
+        if(blockLen == 0)
+            return EOF;
+    }
+
+    return (unsigned char) block[blockPos++];
+}
+
+/*Read the next non negative integer of the file. Returns EOF if there is none.*/
+int lastChar;    /* The character read just after the last integer.*/
+
+int readInt(){
+
+    int c     = nextChar();
+    int value = 0;
+
+    while(c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        c = nextChar();
+
+    if(c < '0' || c > '9')
+        return EOF;
+
+    while(c >= '0' AND c <= '9'){
+
+        value = 10*value + (c - '0');
+        c     = nextChar();
+    }
+
+    lastChar = c;
+    return value;
+}
+
+/*After readInt, returns TRUE if the line of the last integer has no more integers.*/
+int endOfLine(){
+
+    int c = lastChar;
+
+    while(c == ' ' || c == '\r' || c == '\t')
+        c = nextChar();
+
+    if(c == '\n' || c == EOF)
+        return TRUE;
+
+    --blockPos;
+    return FALSE;
+}
+
+/*If the next word of the file is a letter, read it and return it. Otherwise nothing is read and it returns 0.*/
+int readTag(){
+
+    int c = nextChar();
+
+    while(c == ' ' || c == '\n' || c == '\r' || c == '\t')
+        c = nextChar();
+
+    if((c >= 'A' AND c <= 'Z') || (c >= 'a' AND c <= 'z'))
+        return c;
+
+    if(c != EOF)
+        --blockPos;
+
+    return 0;
+}
+
+void openInput(char *fileName){
+
+    input = fopen(fileName, "r");
+
+    if(input == NULL){
+
+        printf("Could not open %s\n", fileName);
+        exit(1);
+    }
+
+    block    = (char*)malloc(BLOCK_SIZE);
+    blockLen = 0;
+    blockPos = 0;
+}
+
+void closeInput(){
+
+    free(block);
+    fclose(input);
+}
+
+void inputError(char *fileName){
+
+    printf("Invalid maze file: %s\n", fileName);
+    exit(1);
+}
+
+/**************************************************************************************/
+
+void readFile(char *fileName){
+
+    int i, j;
+    int weighted;
+
+    openInput(fileName);
+
+    weighted = (readTag() == 'W');
+
+    /* Read the coordinates of Thomas, the coordinates of the exits (a line with one or more pairs) and the number of rows (n)
+       and columns (m). */
+    t1 = readInt();  t2 = readInt();
+
+    numExits = 0;
+    exits    = NULL;
+
+    do{
+        exits = (int*)realloc(exits, 2*(numExits + 1)*sizeof(int));
+        exits[2*numExits]     = readInt();
+        exits[2*numExits + 1] = readInt();
+        numExits++;
+    }while(lastChar != EOF AND !endOfLine());
+
+    n  = readInt();  m  = readInt();
+
+    /* The grids are numbered with an int, so bigger mazes can't be indexed. */
+    if(m <= 0 || n <= 0 || (int64_t)n*m > INT_MAX || !verifyBoundary(t1,t2))
+        inputError(fileName);
+
+    /* The pairs become positions of the vectors. */
+    for(i=0; i < numExits; i++){
+
+        if(!verifyBoundary(exits[2*i], exits[2*i + 1]))
+            inputError(fileName);
+
+        exits[i] = function(exits[2*i], exits[2*i + 1]);
+    }
+
+    s1 = getX(exits[0]);
+    s2 = getY(exits[0]);
+
+    /* Read the maze straight into the wall map (and the costs). */
+    createWallMap();
+
+    if(weighted){
+
+        cost    = (unsigned char*)malloc((size_t)n*m);
+        minCost = 255;
+        maxCost = 1;
+    }
+
+    for (i=0; i < n; i++){
+        for(j=0; j < m; j++){
+
+            int cell = readInt();
+
+            if(cell == EOF || (weighted AND cell > 255))
+                inputError(fileName);
+
+            if(!weighted){
+
+                if(cell != 0)
+                    setWall(i,j);
+
+            }else if(cell == 0)
+                setWall(i,j);
+            else{
+
+                cost[function(i,j)] = (unsigned char) cell;
+                if(cell < minCost) minCost = cell;
+                if(cell > maxCost) maxCost = cell;
+            }
+        }
+    }
+
+    if(minCost > maxCost)
+        minCost = maxCost;
+
+    closeInput();
+
+    initializeGraph();
+}
+
+/**************************************************************************************/
+/* Updating the maze*/
+
+/*  toggleCell turns a free grid into a wall or a wall into a free grid, and repairs dist and prevMask without running the
+    whole BFS again. Only the grids whose distance changes (and their neighbors) are touched.
+
+    1) Opening a grid c: c gets 1 + the smallest distance of its neighbors, and the distances that became smaller are
+       propagated by a BFS that starts at c and only goes on while it improves a distance.
+    2) Closing a grid c: the affected grids are the ones whose shortest paths all pass through c. Going out from c in order of
+       distance, a grid is affected if all its predecessors are affected. Their distances are erased, each of them gets
+       1 + the smallest distance of its neighbors that are not affected, and then they are settled in order of distance, by
+       merging the list of these first distances (sorted) with the queue of the BFS among the affected grids.
+    3) The sets of predecessors of the grids whose distances changed, and of their neighbors, are computed again.
+
+    It works on the distances of the whole maze (not on the ones of A* or of the bidirectional BFS) and on mazes without
+    weights.*/
+
+Bucket   changed;           /* The grids whose distance changed.*/
+Bucket   fifo;
+Bucket   seeds;
+uint64_t *mark = NULL;      /* One bit per grid, the grids of changed that are still to be settled.*/
+
+/*1 + the smallest distance of the neighbors of v that are not marked.*/
+Dist distFromNeighbors(int v){
+
+    int  d;
+    Dist best = INFINITE;
+
+    for(d=0; d < 4; d++){
+
+        int w = neighbor(v,d);
+
+        if(w != EMPTY AND !getBit(mark, w) AND dist[w] != INFINITE AND dist[w] + 1 < best)
+            best = dist[w] + 1;
+    }
+
+    return best;
+}
+
+/*Compute again the set of predecessors of v from the distances.*/
+void repairPredecessors(int v){
+
+    int d, mask = 0;
+
+    if(!isWall(getX(v), getY(v)) AND dist[v] != INFINITE)
+        for(d=0; d < 4; d++){
+
+            int w = neighbor(v,d);
+
+            if(w != EMPTY AND dist[w] + 1 == dist[v])
+                mask |= 1 << d;
+        }
+
+    prevMask[v >> 1] = (prevMask[v >> 1] & (0xF0 >> ((v & 1) << 2))) | (mask << ((v & 1) << 2));
+}
+
+int compareDist(const void *a, const void *b){
+
+    Dist x = dist[*(int*)a], y = dist[*(int*)b];
+
+    return (x > y) - (x < y);
+}
+
+void openCell(int c){
+
+    int i, d;
+
+    clearWall(getX(c), getY(c));
+
+    dist[c] = (exitIndex(c) != EMPTY) ? 0 : distFromNeighbors(c);
+
+    if(dist[c] == INFINITE)
+        return;
+
+    appendList(&changed, c);
+
+    for(i=0; i < changed.size; i++){
+
+        int v = changed.item[i];
+
+        for(d=0; d < 4; d++){
+
+            int w = neighbor(v,d);
+
+            if(w != EMPTY AND dist[v] + 1 < dist[w]){
+
+                dist[w] = dist[v] + 1;
+                appendList(&changed, w);
+            }
+        }
+    }
+}
+
+void closeCell(int c){
+
+    int i, d, s = 0, f = 0;
+
+    if(dist[c] == INFINITE){
+
+        setWall(getX(c), getY(c));
+        return;
+    }
+
+    /*Find the affected grids, in order of distance.*/
+    setBit(mark, c);
+    appendList(&changed, c);
+
+    for(i=0; i < changed.size; i++){
+
+        int v = changed.item[i];
+
+        for(d=0; d < 4; d++){
+
+            int w = neighbor(v,d), k, allMarked = TRUE;
+
+            if(w == EMPTY || getBit(mark, w) || !(getPrevMask(w) & (1 << (d^1))))
+                continue;
+
+            for(k=0; k < 4; k++)
+                if((getPrevMask(w) & (1 << k)) AND !getBit(mark, neighbor(w,k)))
+                    allMarked = FALSE;
+
+            if(allMarked){
+
+                setBit(mark, w);
+                appendList(&changed, w);
+            }
+        }
+    }
+
+    setWall(getX(c), getY(c));
+    clearBit(mark, c);
+    dist[c] = INFINITE;
+
+    /*First distances of the affected grids, from the grids that were not affected.*/
+    for(i=1; i < changed.size; i++){
+
+        int v = changed.item[i];
+
+        dist[v] = distFromNeighbors(v);
+
+        if(dist[v] != INFINITE)
+            appendList(&seeds, v);
+    }
+
+    qsort(seeds.item, seeds.size, sizeof(int), compareDist);
+
+    /*Settle them in order of distance: the smallest of the next seed and the next grid of the queue.*/
+    while(s < seeds.size || f < fifo.size){
+
+        int v;
+
+        while(s < seeds.size AND !getBit(mark, seeds.item[s]))
+            s++;
+
+        if(f < fifo.size AND (s == seeds.size || dist[fifo.item[f]] <= dist[seeds.item[s]]))
+            v = fifo.item[f++];
+        else if(s < seeds.size)
+            v = seeds.item[s++];
+        else
+            break;
+
+        if(!getBit(mark, v))
+            continue;
+
+        clearBit(mark, v);
+
+        for(d=0; d < 4; d++){
+
+            int w = neighbor(v,d);
+
+            if(w != EMPTY AND getBit(mark, w) AND dist[v] + 1 < dist[w]){
+
+                dist[w] = dist[v] + 1;
+                appendList(&fifo, w);
+            }
+        }
+    }
+
+    /*The grids that were not settled are not connected to the exit anymore.*/
+    for(i=0; i < changed.size; i++)
+        clearBit(mark, changed.item[i]);
+}
+
+void toggleCell(int x, int y){
+
+    int i, d;
+    int c = function(x,y);
+
+    if(cost != NULL){
+
+        printf("The maze can only be updated if it has no weights.\n");
+        exit(1);
+    }
+
+    if(mark == NULL)
+        mark = (uint64_t*)calloc(((size_t)n*m + 63) / 64, sizeof(uint64_t));
+
+    changed.size = fifo.size = seeds.size = 0;
+
+    if(isWall(x,y))
+        openCell(c);
+    else
+        closeCell(c);
+
+    repairPredecessors(c);
+
+    for(i=0; i < changed.size; i++){
+
+        int v = changed.item[i];
+
+        repairPredecessors(v);
+
+        for(d=0; d < 4; d++)
+            if(verifyBoundary(getX(v) + stepX[d], getY(v) + stepY[d]))
+                repairPredecessors(function(getX(v) + stepX[d], getY(v) + stepY[d]));
+    }
+
+    for(d=0; d < 4; d++)
+        if(verifyBoundary(x + stepX[d], y + stepY[d]))
+            repairPredecessors(function(x + stepX[d], y + stepY[d]));
+
+    /*The numbers of paths are not valid anymore.*/
+    free(count);
+    free(countState);
+    free(countFrame);
+    free(countNext);
+    count         = NULL;
+    countState    = NULL;
+    countFrame    = NULL;
+    countNext     = NULL;
+    countOverflow = FALSE;
+
+    free(exitOf);
+    exitOf = NULL;
+}
+
+/*Each line of the file is a grid "x y" to toggle.*/
+void applyUpdates(char *fileName){
+
+    int x, y;
+
+    openInput(fileName);
+
+    while((x = readInt()) != EOF AND (y = readInt()) != EOF)
+        if(verifyBoundary(x,y))
+            toggleCell(x,y);
+
+    closeInput();
+}
+
+/**************************************************************************************/
+/* Distance field file*/
+
+/*  The BFS computes the distance from the exit to every grid, so the result (the wall map, dist and prevMask) can be saved
+    once and mapped by later runs instead of reading the maze and running the BFS again.
+
+    The file is a FieldHeader followed by the wall map, dist, prevMask, the exits and, for a weighted maze, the costs, each
+    one starting at a multiple of 64 bytes.*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define FIELD_MAGIC 0x32444650  /* "PFD2" */
+
+typedef struct{
+    uint32_t magic;
+    int32_t  n, m;
+    int32_t  s1, s2;
+    int32_t  t1, t2;
+    int32_t  rowWords;
+    int32_t  minCost, maxCost;
+    int32_t  weighted;      /* TRUE if the costs are saved at costOffset.*/
+    int32_t  numExits;
+    uint64_t wallOffset, distOffset, prevOffset, exitOffset, costOffset, fileSize;
+}FieldHeader;
+
+size_t align64(size_t value){
+
+    return (value + 63) & ~(size_t)63;
+}
+
+/*The place of each array in a file with h->n x h->m grids, h->numExits exits and, if h->weighted, the costs.*/
+void fieldLayout(FieldHeader *h){
+
+    size_t grids = (size_t)h->n*h->m;
+
+    h->magic      = FIELD_MAGIC;
+    h->rowWords   = (h->m + 63) / 64;
+    h->wallOffset = align64(sizeof(FieldHeader));
+    h->distOffset = align64(h->wallOffset + (size_t)h->n*h->rowWords*sizeof(uint64_t));
+    h->prevOffset = align64(h->distOffset + grids*sizeof(Dist));
+    h->exitOffset = align64(h->prevOffset + (grids + 1) / 2);
+    h->costOffset = align64(h->exitOffset + (size_t)h->numExits*sizeof(int));
+    h->fileSize   = h->weighted ? h->costOffset + grids : h->exitOffset + (size_t)h->numExits*sizeof(int);
+}
+
+void writeAt(FILE *fp, uint64_t offset, void *data, size_t bytes){
+
+    fseeko(fp, (off_t)offset, SEEK_SET);
+    fwrite(data, 1, bytes, fp);
+}
+
+void saveField(char *fileName){
+
+    FieldHeader h;
+    FILE        *fp = fopen(fileName, "wb");
+
+    if(fp == NULL){
+
+        printf("Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    memset(&h, 0, sizeof(FieldHeader));
+    h.n        = n;    h.m  = m;
+    h.s1       = s1;   h.s2 = s2;
+    h.t1       = t1;   h.t2 = t2;
+    h.minCost  = minCost;
+    h.maxCost  = maxCost;
+    h.weighted = (cost != NULL);
+    h.numExits = numExits;
+    fieldLayout(&h);
+
+    writeAt(fp, 0, &h, sizeof(FieldHeader));
+    writeAt(fp, h.wallOffset, wall, (size_t)n*rowWords*sizeof(uint64_t));
+    writeAt(fp, h.distOffset, dist, (size_t)n*m*sizeof(Dist));
+    writeAt(fp, h.prevOffset, prevMask, ((size_t)n*m + 1) / 2);
+    writeAt(fp, h.exitOffset, exits, (size_t)numExits*sizeof(int));
+
+    if(h.weighted)
+        writeAt(fp, h.costOffset, cost, (size_t)n*m);
+
+    fclose(fp);
+}
+
+/*Map a saved field. wall, dist and prevMask point into the file. The mapping is private, so updates never change the file.*/
+void loadField(char *fileName){
+
+    struct stat st;
+    FieldHeader *h, layout;
+    char        *base;
+    int         i;
+    int         fd = open(fileName, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FieldHeader)){
+
+        printf("Could not open %s\n", fileName);
+        exit(1);
+    }
+
+    base = (char*)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(base == MAP_FAILED)
+        inputError(fileName);
+
+    h = (FieldHeader*)base;
+
+    if(h->magic != FIELD_MAGIC || h->n <= 0 || h->m <= 0 || (int64_t)h->n*h->m > INT_MAX ||
+       h->numExits <= 0 || h->numExits > h->n*h->m || (h->weighted != FALSE AND h->weighted != TRUE))
+        inputError(fileName);
+
+    /*The offsets are not trusted: they must be the ones saveField would write for this size.*/
+    layout = *h;
+    fieldLayout(&layout);
+
+    if(memcmp(&layout, h, sizeof(FieldHeader)) != 0 || h->fileSize != (uint64_t)st.st_size)
+        inputError(fileName);
+
+    n  = h->n;   m  = h->m;
+    s1 = h->s1;  s2 = h->s2;
+    t1 = h->t1;  t2 = h->t2;
+    rowWords = h->rowWords;
+    minCost  = h->minCost;
+    maxCost  = h->maxCost;
+
+    if(!verifyBoundary(s1,s2) || !verifyBoundary(t1,t2) || minCost < 1 || maxCost < minCost || maxCost > 255)
+        inputError(fileName);
+
+    wall     = (uint64_t*)(base + h->wallOffset);
+    dist     = (Dist*)(base + h->distOffset);
+    prevMask = (unsigned char*)(base + h->prevOffset);
+    exits    = (int*)(base + h->exitOffset);
+    numExits = h->numExits;
+    cost     = h->weighted ? (unsigned char*)(base + h->costOffset) : NULL;
+
+    for(i=0; i < numExits; i++)
+        if(exits[i] < 0 || exits[i] >= n*m)
+            inputError(fileName);
+}
+
+/**************************************************************************************/
+/* Batch queries*/
+
+/*  Each line of the query file is a start grid "x y". For each one it prints "x y distance count", where distance is -1 if
+    there is no path (and the index of its nearest exit if there are several exits), followed by the first maxPaths shortest
+    paths from that grid. The path counts are kept between the
+    queries, so grids shared by many queries are counted only once.*/
+
+void answerQueries(char *fileName, long maxPaths){
+
+    int x, y;
+
+    openInput(fileName);
+
+    while((x = readInt()) != EOF AND (y = readInt()) != EOF){
+
+        int v;
+
+        if(!verifyBoundary(x,y)){
+
+            printf("%d %d invalid\n", x, y);
+            continue;
+        }
+
+        v = function(x,y);
+
+        if(dist[v] == INFINITE){
+
+            printf("%d %d -1 0\n", x, y);
+            continue;
+        }
+
+        printf("%d %d %" PRIu32 " ", x, y, dist[v]);
+        printCount(countPaths(v));
+
+        if(numExits > 1)
+            printf(" %d", nearestExit(v));
+
+        printf("\n");
+
+        if(maxPaths > 0)
+            printAllPaths(v, maxPaths);
+    }
+
+    closeInput();
+}
+
+/**************************************************************************************/
+/* Maze generator*/
+
+/*  Mazes of any size for the benchmarks, from the seed of the random numbers (-seed):
+
+    1) rooms:   an open floor plan, split in rooms of ROOM x ROOM grids by walls with one door in each side of a room.
+    2) perfect: a perfect maze (a single path between any two grids) carved by a depth first search with an explicit stack.
+                The grids with both coordinates even are the rooms and the others are walls until they are carved.
+    3) random:  each grid is a wall with probability density.
+
+    Thomas is at (0,0) and the exit at the opposite corner (the last even row and column for the perfect maze).*/
+
+#define ROOM    16
+
+void createMaze(int rows, int columns){
+
+    n        = rows;
+    m        = columns;
+    numExits = 1;
+    exits    = (int*)malloc(sizeof(int));
+
+    createWallMap();
+}
+
+void generateRooms(){
+
+    int x, y;
+
+    for(x=0; x < n; x++)
+        for(y=0; y < m; y++)
+            if((x % ROOM == ROOM - 1 AND x != n - 1) || (y % ROOM == ROOM - 1 AND y != m - 1))
+                setWall(x,y);
+
+    /*A door in the wall below and in the wall at the right of each room.*/
+    for(x=0; x < n; x += ROOM)
+        for(y=0; y < m; y += ROOM){
+
+            /*The rooms of the last row and column may be smaller, and their doors must stay inside the maze.*/
+            int doorY = y + (int)(nextRandom() % (m - y < ROOM - 1 ? m - y : ROOM - 1));
+            int doorX = x + (int)(nextRandom() % (n - x < ROOM - 1 ? n - x : ROOM - 1));
+
+            if(x + ROOM - 1 < n - 1)
+                clearWall(x + ROOM - 1, doorY);
+            if(y + ROOM - 1 < m - 1)
+                clearWall(doorX, y + ROOM - 1);
+        }
+}
+
+void generatePerfect(){
+
+    int    sp = 0;
+    int    *stack;
+    size_t x, y;
+
+    for(x=0; x < (size_t)n; x++)
+        for(y=0; y < (size_t)m; y++)
+            setWall((int)x, (int)y);
+
+    stack    = (int*)malloc(((size_t)(n+1)/2 * ((m+1)/2) + 1)*sizeof(int));
+    stack[0] = function(0,0);
+    clearWall(0,0);
+
+    while(sp >= 0){
+
+        int v = stack[sp];
+        int d, options[4], numOptions = 0;
+
+        /*The rooms two steps away that were not carved yet.*/
+        for(d=0; d < 4; d++){
+
+            int nx = getX(v) + 2*stepX[d];
+            int ny = getY(v) + 2*stepY[d];
+
+            if(verifyBoundary(nx,ny) AND isWall(nx,ny))
+                options[numOptions++] = d;
+        }
+
+        if(numOptions == 0){
+
+            --sp;
+            continue;
+        }
+
+        d = options[nextRandom() % numOptions];
+
+        clearWall(getX(v) + stepX[d], getY(v) + stepY[d]);
+        clearWall(getX(v) + 2*stepX[d], getY(v) + 2*stepY[d]);
+        stack[++sp] = function(getX(v) + 2*stepX[d], getY(v) + 2*stepY[d]);
+    }
+
+    free(stack);
+}
+
+void generateRandom(double density){
+
+    int      x, y;
+    uint64_t threshold = (uint64_t)(density * 18446744073709551615.0);
+
+    for(x=0; x < n; x++)
+        for(y=0; y < m; y++)
+            if(nextRandom() < threshold)
+                setWall(x,y);
+}
+
+/*Build the wall map of a generated maze. Returns FALSE if the kind is unknown.*/
+int generateMaze(char *kind, int rows, int columns, double density){
+
+    createMaze(rows, columns);
+
+    t1 = 0;
+    t2 = 0;
+    s1 = n - 1;
+    s2 = m - 1;
+
+    if(strcmp(kind, "rooms") == 0)
+        generateRooms();
+    else if(strcmp(kind, "perfect") == 0){
+
+        generatePerfect();
+        s1 = (n - 1) & ~1;
+        s2 = (m - 1) & ~1;
+    }else if(strcmp(kind, "random") == 0)
+        generateRandom(density);
+    else
+        return FALSE;
+
+    clearWall(t1,t2);
+    clearWall(s1,s2);
+    exits[0] = function(s1,s2);
+
+    return TRUE;
+}
+
+/*Write the maze in the format of maze.txt.*/
+void writeMaze(char *fileName){
+
+    int  x, y;
+    char *line = (char*)malloc(2*(size_t)m + 1);
+    FILE *fp   = fopen(fileName, "w");
+
+    if(fp == NULL){
+
+        printf("Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    fprintf(fp, "%d %d\n%d %d\n%d %d\n", t1, t2, s1, s2, n, m);
+
+    for(x=0; x < n; x++){
+
+        for(y=0; y < m; y++){
+
+            line[2*y]     = isWall(x,y) ? '1' : '0';
+            line[2*y + 1] = ' ';
+        }
+
+        line[2*m - 1] = '\n';
+        fwrite(line, 1, 2*(size_t)m, fp);
+    }
+
+    free(line);
+    fclose(fp);
+}
+
+/**************************************************************************************/
+/* Benchmark*/
+
+/*  -B times each step on the maze separately and prints one line of JSON:
+
+        {"rows":..,"cols":..,"engine":"..","build_s":..,"search_s":..,"count_s":..,"enumerate_s":..,"paths":..,
+         "cells_per_s":..,"peak_rss_kb":..}
+
+    build is generating or reading the maze plus initializeGraph, search is the BFS (or the engine given by -e), count is
+    countPaths from Thomas and enumerate walks the first maxPaths shortest paths (1000 by default). cells_per_s is the number
+    of grids over the search time.
+    The peak memory is the one of the whole process, so each size should run in its own process, for example:
+
+        for s in 100 1000 5000 20000; do ./project1 -g random $s $s -density 0.3 -seed 1 -B -e simd; done*/
+
+#include <time.h>
+#include <sys/resource.h>
+
+double now(){
+
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void search(int engine){
+
+    if(engine == DIAL || engine == ASTAR)
+        bucketSearch(engine == ASTAR);
+    else if(engine == BIDIRECTIONAL)
+        bidirectionalBFS();
+    else if(engine == SIMD)
+        bitsetBFS();
+    else if(engine == PARALLEL)
+        parallelBFS();
+    else{
+
+        createQueue(m*n);
+        modifiedBFS();
+    }
+}
+
+void benchmark(int engine, char *engineName, long maxPaths, double loading){
+
+    struct rusage usage;
+    PathIterator  it;
+    double        start, build, find, counting, enumerate;
+    long          paths = 0;
+    int           Thomas = function(t1,t2);
+    int           *path;
+
+    start = now();
+    initializeGraph();
+    build = loading + now() - start;
+
+    start = now();
+    search(engine);
+    find  = now() - start;
+
+    start    = now();
+    countPaths(Thomas);
+    counting = now() - start;
+
+    start = now();
+    path  = (int*)malloc((maxPathLength(Thomas) + 1)*sizeof(int));
+    startPaths(&it, Thomas, maxPaths > 0 ? maxPaths : 1000);
+
+    while(nextPath(&it, path) > 0)
+        paths++;
+
+    freePaths(&it);
+    free(path);
+    enumerate = now() - start;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"rows\":%d,\"cols\":%d,\"engine\":\"%s\",\"build_s\":%.6f,\"search_s\":%.6f,\"count_s\":%.6f,"
+           "\"enumerate_s\":%.6f,\"paths\":%ld,\"cells_per_s\":%.0f,\"peak_rss_kb\":%ld}\n",
+           n, m, engineName, build, find, counting, enumerate, paths,
+           find > 0 ? (double)n*m / find : 0.0, usage.ru_maxrss);
+}
+
+int main(int argc, char *argv[]){
+
+    int    i;
+    int    countOnly  = FALSE;
+    int    engine     = SCALAR;
+    long   maxPaths   = 0;
+    long   samples    = 0;
+    char   *queryFile = NULL;
+    char   *fieldIn   = NULL;
+    char   *fieldOut  = NULL;
+    char   *updates   = NULL;
+    char   *binary    = NULL;
+    char   *engineName = "scalar";
+    char   *kind      = NULL;
+    char   *mazeOut   = NULL;
+    int    rows       = 0, columns = 0;
+    int    bench      = FALSE;
+    double density    = 0.3;
+    double start;
+
+    for(i=1; i < argc; i++){
+
+        if(strcmp(argv[i], "-c") == 0)
+            countOnly = TRUE;
+        else if(strcmp(argv[i], "-t") == 0 AND i+1 < argc)
+            numThreads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-q") == 0 AND i+1 < argc)
+            queryFile = argv[++i];
+        else if(strcmp(argv[i], "-k") == 0 AND i+1 < argc)
+            maxPaths = atol(argv[++i]);
+        else if(strcmp(argv[i], "-r") == 0 AND i+1 < argc)
+            samples = atol(argv[++i]);
+        else if(strcmp(argv[i], "-seed") == 0 AND i+1 < argc)
+            seedRandom(strtoull(argv[++i], NULL, 10));
+        else if(strcmp(argv[i], "-l") == 0 AND i+1 < argc)
+            fieldIn = argv[++i];
+        else if(strcmp(argv[i], "-s") == 0 AND i+1 < argc)
+            fieldOut = argv[++i];
+        else if(strcmp(argv[i], "-u") == 0 AND i+1 < argc)
+            updates = argv[++i];
+        else if(strcmp(argv[i], "-b") == 0 AND i+1 < argc)
+            binary = argv[++i];
+        else if(strcmp(argv[i], "-d") == 0 AND i+1 < argc){
+
+            decodePaths(argv[++i]);
+            return 0;
+        }
+        else if(strcmp(argv[i], "-g") == 0 AND i+3 < argc){
+
+            kind    = argv[++i];
+            rows    = atoi(argv[++i]);
+            columns = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-density") == 0 AND i+1 < argc)
+            density = atof(argv[++i]);
+        else if(strcmp(argv[i], "-w") == 0 AND i+1 < argc)
+            mazeOut = argv[++i];
+        else if(strcmp(argv[i], "-B") == 0)
+            bench = TRUE;
+        else if(strcmp(argv[i], "-e") == 0 AND i+1 < argc){
+
+            engineName = argv[++i];
+            if(strcmp(argv[i], "scalar") == 0)
+                engine = SCALAR;
+            else if(strcmp(argv[i], "simd") == 0)
+                engine = SIMD;
+            else if(strcmp(argv[i], "parallel") == 0)
+                engine = PARALLEL;
+            else if(strcmp(argv[i], "dial") == 0)
+                engine = DIAL;
+            else if(strcmp(argv[i], "astar") == 0)
+                engine = ASTAR;
+            else if(strcmp(argv[i], "bidir") == 0)
+                engine = BIDIRECTIONAL;
+            else{
+
+                printf("Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+
+    /*A* and bidir stop when they reach Thomas, so the distances and predecessors of the other grids are not final.*/
+    if(fieldIn == NULL AND (engine == ASTAR || engine == BIDIRECTIONAL) AND
+       (queryFile != NULL || fieldOut != NULL || updates != NULL)){
+
+        printf("-e %s only finds the paths of Thomas: it can't be used with -q, -s or -u.\n", engineName);
+        return 1;
+    }
+
+    if(fieldIn != NULL)
+        loadField(fieldIn);
+    else{
+
+        start = now();
+
+        if(kind != NULL){
+
+            if((int64_t)rows*columns > INT_MAX){
+
+                printf("The maze is too big: rows*columns must fit in an int\n");
+                return 1;
+            }
+
+            if(rows <= 0 || columns <= 0 || !generateMaze(kind, rows, columns, density)){
+
+                printf("Unknown maze: -g rooms|perfect|random rows columns\n");
+                return 1;
+            }
+
+            if(mazeOut != NULL){
+
+                writeMaze(mazeOut);
+                return 0;
+            }
+
+            if(bench){
+
+                benchmark(engine, engineName, maxPaths, now() - start);
+                return 0;
+            }
+
+            initializeGraph();
+        }else
+            readFile("maze.txt");
+
+        /*The BFS engines only know steps of cost 1.*/
+        if(cost != NULL AND engine != ASTAR){
+
+            engine     = DIAL;
+            engineName = "dial";
+        }
+
+        if(bench){
+
+            double loading = now() - start;
+
+            free(dist);
+            free(prevMask);
+            benchmark(engine, engineName, maxPaths, loading);
+            return 0;
+        }
+
+        search(engine);
+    }
+
+    if(updates != NULL)
+        applyUpdates(updates);
+
+    if(fieldOut != NULL)
+        saveField(fieldOut);
+
+    if(queryFile != NULL){
+
+        if(binary != NULL)
+            openBinaryOutput(binary);
+
+        answerQueries(queryFile, maxPaths);
+
+        if(binary != NULL)
+            closeBinaryOutput();
+
+        return 0;
+    }
+
+    if(countOnly){
+
+        Count c = countPaths(function(t1,t2));
+
+        printf("Number of shortest paths: ");
+        printCount(c);
+        printf(countOverflow ? " (or more)\n" : "\n");
+
+        return 0;
+    }
+
+    if(binary != NULL)
+        openBinaryOutput(binary);
+
+    if(samples > 0){
+
+        int v     = function(t1,t2);
+        int *path = (int*)malloc((maxPathLength(v) + 1)*sizeof(int));
+
+        for(i=0; i < samples; i++){
+
+            int length = samplePath(v, path);
+
+            if(length == 0)
+                break;
+
+            printPath(path, length);
+        }
+
+        free(path);
+
+        if(countOverflow){
+
+            printf("There are too many shortest paths to sample them uniformly.\n");
+            return 0;
+        }
+    }else
+        printAllPaths(function(t1,t2), -1);
 
-    printAllPaths(function(t1,t2));
+    if(binary != NULL)
+        closeBinaryOutput();
 
     if(pathExist == FALSE)
         printf("Nao existe caminho entre Thomas e a saida.\n");
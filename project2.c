@@ -1,211 +1,2891 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
-#define UPPER_LETER(l)  (int) l < 91
-#define OCCUPIED            1
-#define EMPTY               0
-#define MOD                 %
+#define AND                 &&
+#define TRUE                1
+#define FALSE               0
+#define BLANK(c)            ((unsigned char)(c) <= ' ')
+
+/* Grouping engines (-e).*/
+#define HASH                0
+#define SORT                1
 
 /*	Nome: Tiago Trocoli
     Email: tiago1trocoli@gmail.com
     
-    Description: The program finds the greatest set of anagram in a text file using the Fundamental Theorem of Arithmetic.
+    Description: The program finds the greatest set of anagram in a text file by counting the letters of each word.
+*/
+
+
+/* How the program works:
+
+    1) Run it with the file name (ex: ./project2 dictionary.txt), or run it alone and write the name when asked.
+    2) It prints every set of anagrams of the greatest size.
+
+    Options:
+    -stats      also print how the hash table behaved (groups, load, blocks probed per lookup).
+    -e engine   how the words are grouped: hash (the default, a hash table of signatures) or sort (a radix sort of them).
+    -save file  also write the groups to an anagram index (a binary file that can be mapped).
+    -load file  do not read a dictionary: map the index and print the anagrams of every word of the queries.
+    -q file     the queries for -load, any number of words per line (default: the standard input).
+    -u file     update the dictionary before anything else: one "+word" (add), "-word" (remove) or "?" (print the size of
+                the greatest set) per line.
+    -r file     instead of the greatest set, print the words that can be built with the letters of each word (rack) of file.
+    -stream     read the words as they come (the file, or the standard input if there is none), without keeping them,
+                and print the K greatest sets every N words and at the end. Uses at most about M megabytes.
+    -k K        (default 10)
+    -every N    (default 1000000, 0 = only at the end)
+    -m M        (default 256)
+    -json       also print a JSON report of times, probes, collisions and memory at the end (see report).
+    -B          benchmark: the JSON report without the sets.
+    -gen N file write a synthetic corpus of N words made from the dictionary, and stop (-seed S, default 1).
+    -t N        group the words with N threads (0 = one per processor), with the hash engine. The sets are the same as with one thread.
 */
 
 
-/* In my computer, this program takes +/- 27s to find the solution.*/
+/* In my computer, this program took +/- 27s with the prime products. With letter count signatures it takes +/- 0.1s.*/
 
 /**********************************************************************************************************************************************/
 
-/* There are no words with more than 24 + '\0' letters.*/
+/*  The file is mapped into memory and never copied. A word is just where it starts in the text and how long it is,
+    so there is no limit on its length. Words are separated by blanks (any byte up to ' ', so "\r\n" works too).*/
 typedef struct{
-    char string[25];
+    uint64_t offset;    /* position of the first letter in text.*/
+    uint32_t length;
 }Word;
 
-Word *buffer = NULL;
-int size = 1;
+char     *text      = NULL;
+uint64_t textSize   = 0;
+Word     *buffer    = NULL;
+int      size       = 0;
+
+#ifdef __SSE2__
+/* Bit i is set when p[i] is a blank, for the 16 bytes starting at p. max(c, ' ') == ' ' is an unsigned c <= ' '.*/
+static inline int blankMask(char *p){
+
+    __m128i chunk = _mm_loadu_si128((__m128i*)p);
+    __m128i space = _mm_set1_epi8(' ');
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(chunk, space), space));
+}
+#endif
+
+/*  Find the first position of base from pos on that is a blank (blank = TRUE) or a letter (blank = FALSE).
+    Returns limit if there is none.*/
+uint64_t scanIn(char *base, uint64_t limit, uint64_t pos, int blank){
+
+#ifdef __SSE2__
+    while(pos + 16 <= limit){
+
+        int mask = blankMask(base + pos);
+
+        if(!blank)
+            mask = ~mask & 0xFFFF;
+
+        if(mask)
+            return pos + __builtin_ctz(mask);
+
+        pos += 16;
+    }
+#endif
+
+    while(pos < limit AND BLANK(base[pos]) != blank)
+        ++pos;
+
+    return pos;
+}
+
+uint64_t scan(uint64_t pos, int blank){
+
+    return scanIn(text, textSize, pos, blank);
+}
+
+/*  Walk over the words that start between from and to - 1 (a word may end after to). With out = NULL it only counts them,
+    so buffer is allocated once with the right size.*/
+int tokenize(uint64_t from, uint64_t to, Word *out){
+
+    int      count = 0;
+    uint64_t pos   = from;
+
+    /* The word that crosses from belongs to the chunk before.*/
+    if(pos > 0 AND pos < textSize AND !BLANK(text[pos - 1]))
+        pos = scan(pos, TRUE);
+
+    pos = scan(pos, FALSE);
+
+    while(pos < to){
+
+        uint64_t end = scan(pos, TRUE);
+
+        if(out != NULL){
+
+            out[count].offset = pos;
+            out[count].length = (uint32_t)(end - pos);
+        }
+
+        ++count;
+        pos = scan(end, FALSE);
+    }
+
+    return count;
+}
 
-/* Read the file and copy the words into buffer vector.*/
+/* Map the file.*/
 void readFile(char *fileName){
 
-    FILE* fp;
+    struct stat st;
+    int         fd = open(fileName, O_RDONLY);
 
-    fp = fopen(fileName, "r");
+    if(fd < 0 || fstat(fd, &st) != 0){
 
-    buffer = (Word*)malloc(size*sizeof(Word));
+        printf("Could not open %s\n", fileName);
+        exit(1);
+    }
 
-    while( fscanf(fp,"%s",buffer[size-1].string) != EOF ){
+    textSize = st.st_size;
 
-        buffer = (Word*)realloc(buffer,(size+1)*sizeof(Word));
-        ++size;
+    if(textSize > 0){
+
+        text = (char*)mmap(NULL, textSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(text == MAP_FAILED){
+
+            printf("Could not map %s\n", fileName);
+            exit(1);
+        }
+
+        madvise(text, textSize, MADV_SEQUENTIAL);
     }
 
-    --size;
-    fclose(fp);
+    close(fd);
+}
+
+/* Build the vector of words.*/
+void splitWords(){
+
+    size   = tokenize(0, textSize, NULL);
+    buffer = (Word*)malloc((size + 1)*sizeof(Word));
+    tokenize(0, textSize, buffer);
 }
 
 /**********************************************************************************************************************************************/
 /*
-    In other to check if two words are anagrams we use this theorem below:
-    Fundamental Theorem of Arithmetic (FTA): "every integer greater than 1 either is prime itself or is the product of prime numbers and
-    that this product is unique, up to the order of the factors." (Wikipedia)
+    In other to check if two words are anagrams we give each word a signature: how many times each letter appears in it.
+    X and Y are anagrams if and only if they have the same letter counts, no matter the order. Example:
+
+    sign(Ana) = {a: 2, n: 1}
+    sign(naa) = {a: 2, n: 1}
+
+    The old version multiplied one prime per letter (a -> 2, ..., z -> 101) into a uint64_t. That is the same idea by the
+    Fundamental Theorem of Arithmetic, but the product overflows for long words and then different words could share a number.
 */
 
-/*  To use this fact, fist we create a list that maps each letter into a prime number.
-    So, a/A -> 2, b/B -> 3, ..., z/Z -> 101.*/
-int prime[26] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97, 101};
+/*  The counts are packed into 128 bits, 5 bits per letter (0..31) except j, q, x and z, which are rare and get 4 bits (0..15).
+    22*5 + 4*4 = 126 bits, so two words are compared with a single 128-bit equality.
+    A word with a non-letter or a count that does not fit is marked with SPILLED and signed by all its bytes instead (see
+    spilledSignature), so numbers and words with punctuation do not all fall on the same signature. Equal SPILLED signatures
+    are still only a hint and the words are checked byte by byte (see sameLetters). In dictionary.txt this never happens.*/
+typedef unsigned __int128 Signature;
+
+#define OTHER       26
+#define SPILLED     ((Signature)1 << 127)
+#define BATCH       4096
+
+unsigned char letterOf[256];    /* a/A -> 0, ..., z/Z -> 25, anything else -> OTHER. Folds the case without a branch.*/
+unsigned char foldOf[256];      /* the byte in lower case, used by SPILLED words.*/
+Signature byteCode[256];        /* a random 128-bit number for each byte, see spilledSignature.*/
+int fieldShift[26];             /* where the count of each letter starts in the signature.*/
+uint32_t fieldMax[26];          /* the largest count that fits in it.*/
+
+void initSignature(){
+
+    int      i, bit = 0;
+    uint64_t state  = 0x9E3779B97F4A7C15ULL;
+
+    for(i=0;i<256;i++){
+
+        letterOf[i] = OTHER;
+        foldOf[i]   = i;
+    }
+
+    /* Always the same numbers (splitmix64 from a fixed seed), because the signatures are saved in the index files.*/
+    for(i=0;i<256;i++){
+
+        uint64_t half[2];
+        int      k;
+
+        for(k=0;k<2;k++){
+
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+
+            z       = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z       = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            half[k] = z ^ (z >> 31);
+        }
+
+        byteCode[i] = ((Signature)half[0] << 64) | half[1];
+    }
+
+    for(i=0;i<26;i++){
+
+        int width = (i == 'j'-'a' || i == 'q'-'a' || i == 'x'-'a' || i == 'z'-'a') ? 4 : 5;
 
+        letterOf['a' + i] = letterOf['A' + i] = i;
+        foldOf['A' + i]   = 'a' + i;
+        fieldShift[i]     = bit;
+        fieldMax[i]       = (1u << width) - 1;
+        bit              += width;
+    }
+}
+
+/*  The signature of a SPILLED word: the sum of the byteCode of its bytes, up to case. The sum does not depend on the order, so
+    anagrams still get the same signature, and words with other bytes almost never do.*/
+Signature spilledSignature(char *word, int length){
+
+    Signature sum = 0;
+    int       i;
+
+    for(i=0;i<length;i++)
+        sum += byteCode[foldOf[(unsigned char)word[i]]];
+
+    return sum | SPILLED;
+}
+
+Signature sign(char *word, int length){
 
-/*  Second, we create a function that receives a word as an input and outputs a number which is the multiplication of prime numbers corresponding to
-    each of input's letter. Example:
+    uint32_t  count[OTHER + 1] = {0};
+    Signature sig              = 0;
+    uint32_t  spilled;
+    int       i;
 
-    map(Ana) = 2 * 43 * 2 = 172
-    map(naa) = 43 * 2 * 2 = 172
+    for(i=0;i<length;i++)
+        ++count[letterOf[(unsigned char)word[i]]];
 
-    By the FTA, we conclude that for each input the output is unique and X and Y are anagrams if and only if map(X) = map(Y).*/
+    spilled = count[OTHER];
 
-uint64_t map(char *word){
+    for(i=0;i<26;i++){
+
+        uint32_t c    = count[i];
+        uint32_t over = c > fieldMax[i];
+
+        spilled |= over;
+        c        = over ? fieldMax[i] : c;
+        sig     |= (Signature)c << fieldShift[i];
+    }
+
+    return spilled ? spilledSignature(word, length) : sig;
+}
+
+/* Sign the words first..first+count-1 into out. Done in batches so the letters of the batch are read in one sweep over text.*/
+void signWords(int first, int count, Signature *out){
 
     int i;
-    uint64_t uniqueNum = 1;
 
-    for(i=0; word[i] != '\0';i++){
+    for(i=0;i<count;i++)
+        out[i] = sign(text + buffer[first + i].offset, buffer[first + i].length);
+}
 
-        char c = word[i];
+/* Exact check for SPILLED signatures: the same bytes, up to case. Most of the time it is the same word again.*/
+int sameBytes(char *a, uint32_t lengthA, char *b, uint32_t lengthB){
 
-        if ( UPPER_LETER(c) )
-            uniqueNum *= (prime[c - 65]);
-        else
-            uniqueNum *= (prime[c - 97]);
+    int      histogram[256];
+    uint32_t i, start;
+
+    if(lengthA != lengthB)
+        return FALSE;
+
+    for(start=0;start<lengthA AND foldOf[(unsigned char)a[start]] == foldOf[(unsigned char)b[start]];start++);
+
+    if(start == lengthA)
+        return TRUE;
+
+    memset(histogram, 0, sizeof(histogram));
+
+    for(i=start;i<lengthA;i++){
+
+        ++histogram[foldOf[(unsigned char)a[i]]];
+        --histogram[foldOf[(unsigned char)b[i]]];
     }
 
-    return uniqueNum;
+    for(i=0;i<256;i++)
+        if(histogram[i] != 0)
+            return FALSE;
+
+    return TRUE;
+}
+
+int sameLetters(Word *x, Word *y){
+
+    return sameBytes(text + x->offset, x->length, text + y->offset, y->length);
+}
+
+/* Spread the 128 bits over a 64-bit hash.*/
+uint64_t hashSignature(Signature sig){
+
+    uint64_t h = (uint64_t)sig ^ ((uint64_t)(sig >> 64) * 0x9E3779B97F4A7C15ULL);
+
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/**********************************************************************************************************************************************/
+/*Instrumentation*/
+
+/*  With -json the program also measures where the time goes and prints one line of JSON at the end (see report).
+    The timers are read a batch of words at a time, and only with the flag on, so without it nothing changes.*/
+
+#include <time.h>
+#include <sys/resource.h>
+#include <malloc.h>
+
+#define PROBE_BUCKETS   17      /* lookups that visited 1, 2, ..., 16 blocks, and more than 16.*/
+
+int    instrument   = FALSE;
+double startTime    = 0;
+double loadTime     = 0;        /* mapping the file and finding the words.*/
+double signTime     = 0;        /* computing the signatures (and their hashes).*/
+double groupTime    = 0;        /* the hash tables, or the radix sort and its runs.*/
+double layoutTime   = 0;        /* the CSR arrays.*/
+
+double now(){
+
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec * 1e-9;
 }
 
 /**********************************************************************************************************************************************/
 /*Hash Table functions and data structure*/
 
-/*Every element of the Hash Table is a Slot and it stores the set of anagrams.*/
+/*  The Hash Table is a "Swiss table". The slots are split into blocks of 16 and every slot has a control byte:
+    EMPTY_TAG if it is free, otherwise 7 bits of the hash of its signature. A lookup loads the 16 control bytes of a block
+    at once (SSE2) and only compares the signatures whose tag matches, so most probes never touch a key.
+    The capacity is a power of two, so the block is picked with a mask, and the blocks are visited 1, 2, 3... apart,
+    which reaches all of them. The keys and the group numbers are kept in their own arrays, apart from the control bytes.*/
+#define BLOCK       16
+#define EMPTY_TAG   0x80
+
+/* Probe statistics, printed with -stats.*/
 typedef struct{
-    uint64_t uniqueNum;     /* map(word) = uniqueNum.*/
-    int setOfAnagrams[20]; /* It stores the positions of words corresponding to the vector buffer (not the words!).*/
-    int sizeSet;            /* The number of anagrams in this slot (max = 20).*/
-    int isEmpty;
-}Slot;
+    uint64_t lookups;
+    uint64_t blocks;        /* blocks visited by all lookups.*/
+    uint64_t falseTags;     /* tags that matched a different signature.*/
+    uint64_t collisions;    /* SPILLED signatures that matched words with other letters.*/
+    int longest;            /* most blocks visited by one lookup.*/
+    uint64_t histogram[PROBE_BUCKETS];  /* lookups by blocks visited, only with -json.*/
+}ProbeStats;
 
 typedef struct{
-    int size;
-    Slot *slot;
+    uint64_t capacity;      /* number of slots, a power of two.*/
+    uint64_t blockMask;     /* capacity/BLOCK - 1.*/
+    unsigned char *ctrl;    /* control byte of each slot.*/
+    Signature *key;         /* signature of each slot.*/
+    int *group;             /* group number of each slot, in order of first appearance.*/
+    int numGroups;
+    int *first;             /* the first word of each group, used by sameLetters.*/
+    int *count;             /* the number of words of each group.*/
+    ProbeStats stats;
 }Hash;
 
-Hash *H = NULL;
-int greaterSet = 0;         /* The size of the greatest set of anagrams.*/
+Hash *H         = NULL;
+Hash *tables    = NULL;     /* all the tables in use: H alone, or the shards of the parallel version.*/
+int  numTables  = 0;
+int greaterSet  = 0;        /* The size of the greatest set of anagrams.*/
+
+/*  The sets themselves live outside the table, in two arrays (like a CSR matrix):
+    the words of group g are members[groupStart[g]] ... members[groupStart[g+1] - 1], as positions in the vector buffer.
+    They are built in two passes: first count the words of each group, then lay them out. The old Slot kept setOfAnagrams[20]
+    inside every slot (+/- 39 megabytes for dictionary.txt, and a set of 21 words would overrun it). Now the sets take
+    one int per word plus one per group, and a set can have any size.*/
+int numGroups   = 0;
+int *groupOf    = NULL;     /* the group of each word.*/
+int *groupStart = NULL;     /* numGroups + 1 offsets into members.*/
+int *members    = NULL;
+
+#define FIRST_CAPACITY  1024
+#define PREFETCH        8
+
+/* Give T capacity empty slots. first and count only need capacity entries, since the table never gets full.*/
+void allocTable(Hash *T, uint64_t capacity){
+
+    T->capacity  = capacity;
+    T->blockMask = capacity/BLOCK - 1;
+    T->ctrl      = (unsigned char*)malloc(capacity);
+    T->key       = (Signature*)malloc(capacity*sizeof(Signature));
+    T->group     = (int*)malloc(capacity*sizeof(int));
+    T->first     = (int*)realloc(T->first, capacity*sizeof(int));
+    T->count     = (int*)realloc(T->count, capacity*sizeof(int));
+
+    memset(T->ctrl, EMPTY_TAG, capacity);
+}
+
+/* The table grows with the number of groups, not of words, so for a big file with few groups it stays small and in cache.*/
+void createTable(Hash *T){
 
-/* As you may note, my program consumes quite a few memory. For 235886 words in the dictionary.txt, my hash table uses +/- 39 megabytes. */
-/* because for the sake of efficiency, I prefer to allocate setOfAnagrams statically instead of dynamically as the hash is populated.*/
+    memset(T, 0, sizeof(Hash));
+    allocTable(T, FIRST_CAPACITY);
+}
 
+/* The arrays of the groups are sized by the words, since every word may open a group.*/
 void createHash(int size){
 
-    H        = (Hash*)malloc(sizeof(Hash));
-    H->size  = (int) 1.7*size + 1;
-    H->slot  = (Slot*)calloc(H->size, sizeof(Slot));
+    H         = (Hash*)malloc(sizeof(Hash));
+    tables    = H;
+    numTables = 1;
+
+    createTable(H);
+
+    groupOf    = (int*)malloc((size + 1)*sizeof(int));
+    groupStart = (int*)calloc(size + 2, sizeof(int));
+    members    = (int*)malloc((size + 1)*sizeof(int));
+}
+
+/* Bit i is set when ctrl[i] == tag, for the 16 control bytes of a block.*/
+static inline int matchTag(unsigned char *ctrl, unsigned char tag){
+
+#ifdef __SSE2__
+    __m128i block = _mm_loadu_si128((__m128i*)ctrl);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8((char)tag)));
+#else
+    int i, mask = 0;
+
+    for(i=0;i<BLOCK;i++)
+        mask |= (ctrl[i] == tag) << i;
+
+    return mask;
+#endif
+}
+
+void countProbe(Hash *T, int blocks){
+
+    ++T->stats.lookups;
+    T->stats.blocks += blocks;
+
+    if(T->stats.longest < blocks)
+        T->stats.longest = blocks;
+
+    if(instrument)
+        ++T->stats.histogram[(blocks < PROBE_BUCKETS ? blocks : PROBE_BUCKETS) - 1];
+}
+
+/* The slot a new signature goes to: the first free slot along its probe sequence.*/
+uint64_t freeSlot(Hash *T, uint64_t h){
+
+    uint64_t block = h & T->blockMask;
+    int      step  = 0;
+    int      mask;
+
+    while(!(mask = matchTag(T->ctrl + block*BLOCK, EMPTY_TAG))){
+
+        ++step;
+        block = (block + step) & T->blockMask;
+    }
+
+    return block*BLOCK + __builtin_ctz(mask);
+}
+
+/* Double the table and put every signature back. Called before it gets more than 7/8 full.*/
+void growHash(Hash *T){
+
+    unsigned char *ctrl     = T->ctrl;
+    Signature     *key      = T->key;
+    int           *group    = T->group;
+    uint64_t      capacity  = T->capacity;
+    uint64_t      i;
+
+    allocTable(T, 2*capacity);
+
+    for(i=0;i<capacity;i++){
+
+        if(ctrl[i] != EMPTY_TAG){
 
+            uint64_t h = hashSignature(key[i]);
+            uint64_t k = freeSlot(T, h);
+
+            T->ctrl[k]  = h >> 57;
+            T->key[k]   = key[i];
+            T->group[k] = group[i];
+        }
+    }
+
+    free(ctrl);
+    free(key);
+    free(group);
 }
 
+/* Find the group of a word in T and count the word, opening a new group if its signature is new. Returns the group's number.*/
+int insertHash(Hash *T, Signature sig, uint64_t h, int position){
+
+    unsigned char tag   = h >> 57;              /* the top 7 bits; the low bits pick the block.*/
+    uint64_t      block = h & T->blockMask;
+    int           step  = 0;
+    int           g;
+
+    while(TRUE){
+
+        unsigned char *ctrl = T->ctrl + block*BLOCK;
+        int           mask  = matchTag(ctrl, tag);
+        uint64_t      k;
+
+        /* Compare the signatures whose tag matches...*/
+        while(mask){
 
-/* Insert each word of the buffer vector in the Hash Table... */
-void insertHash(char *str, int position){
+            k = block*BLOCK + __builtin_ctz(mask);
+            g = T->group[k];
 
-    uint64_t uniqueNum          = map(str);
-    Slot *slot                  = H->slot;
-    int h                       = 0;
-    int stop                    = 0;
-    int i                       = 0;
+            if(T->key[k] == sig){
 
-    uint32_t key;
+                if(!(sig & SPILLED) || sameLetters(&buffer[T->first[g]], &buffer[position])){
 
-    while(!stop){
+                    countProbe(T, step + 1);
+                    ++T->count[g];
+                    return g;
+                }
 
-        key = (uniqueNum + i + i*i) MOD H->size;    /* hash function. */
+                ++T->stats.collisions;
+            }else
+                ++T->stats.falseTags;
 
-        /* If this slot is empty...*/
-        if(slot[key].isEmpty == EMPTY){
+            mask &= mask - 1;
+        }
+
+        /* Nothing is ever removed, so a free slot in this block means the signature is new.*/
+        mask = matchTag(ctrl, EMPTY_TAG);
 
-            slot[key].setOfAnagrams[slot->sizeSet]  = position;  /* store the position of this word corresponding to buffer vector.*/
-            slot[key].uniqueNum                     = uniqueNum; /* store its unique number.*/
-            slot[key].isEmpty                       = OCCUPIED;
-            stop                                    = 1;
-            ++slot[key].sizeSet;                                 /* increase the size of the set.*/
+        if(mask){
 
-        /* If this slot is not empty but this word belongs to the slot's set of anagrams...*/
-        }else if(slot[key].uniqueNum == uniqueNum){
+            if((uint64_t)T->numGroups + 1 > T->capacity - T->capacity/8){
 
-            slot[key].setOfAnagrams[slot[key].sizeSet] = position;
-            stop                                       = 1;
-            ++slot[key].sizeSet;
+                growHash(T);
+                k = freeSlot(T, h);
+            }else
+                k = block*BLOCK + __builtin_ctz(mask);
 
+            g            = T->numGroups++;
+            T->ctrl[k]   = tag;
+            T->key[k]    = sig;
+            T->group[k]  = g;
+            T->first[g]  = position;
+            T->count[g]  = 1;
+
+            countProbe(T, step + 1);
+            return g;
         }
 
-        /* Otherwise, find another slot.*/
-        ++h;
-        ++i;
+        /* Otherwise, try another block.*/
+        ++step;
+        block = (block + step) & T->blockMask;
     }
+}
 
-    /* Update size of the greatest set of anagrams.*/
-    if(greaterSet < slot[key].sizeSet)
-        greaterSet = slot[key].sizeSet;
+/* Ask for the block of a signature a few lookups ahead, so its cache misses overlap with the current one.*/
+static inline void prefetchHash(Hash *T, uint64_t h){
 
+    uint64_t block = h & T->blockMask;
+
+    __builtin_prefetch(T->ctrl + block*BLOCK);
+    __builtin_prefetch(T->key + block*BLOCK);
 }
 
-/* Populate the Hash Table with words.*/
+/* First pass: sign the words a batch at a time, find their groups and count the size of each group.*/
 void populateHash(){
 
-    int i;
+    Signature batch[BATCH];
+    uint64_t  hash[BATCH];
+    int i, j;
+
+    initSignature();
+
+    for(i=0;i<size;i+=BATCH){
+
+        int    count = (size - i < BATCH) ? size - i : BATCH;
+        double t     = instrument ? now() : 0;
+
+        signWords(i, count, batch);
+
+        for(j=0;j<count;j++)
+            hash[j] = hashSignature(batch[j]);
+
+        if(instrument){
+
+            signTime  += now() - t;
+            t          = now();
+        }
+
+        for(j=0;j<count;j++){
+
+            if(j + PREFETCH < count)
+                prefetchHash(H, hash[j + PREFETCH]);
 
+            groupOf[i + j] = insertHash(H, batch[j], hash[j], i + j);
+        }
+
+        if(instrument)
+            groupTime += now() - t;
+    }
+
+    numGroups = H->numGroups;
+    memcpy(groupStart + 1, H->count, numGroups*sizeof(int));
+}
+
+/* Turn the sizes in groupStart[g + 1] into offsets and find the greatest set.*/
+void groupOffsets(){
+
+    int g;
+
+    for(g=0;g<numGroups;g++){
+
+        if(greaterSet < groupStart[g + 1])
+            greaterSet = groupStart[g + 1];
+
+        groupStart[g + 1] += groupStart[g];
+    }
+}
+
+/* Second pass: drop every word into its group, keeping the order of the file.*/
+void layoutGroups(){
+
+    int g, i;
+
+    groupOffsets();
+
+    /* groupStart[g] is used as the write cursor of group g, so after this loop it points to the start of group g + 1.*/
     for(i=0;i<size;i++)
-        insertHash(buffer[i].string, i);
+        members[groupStart[groupOf[i]]++] = i;
+
+    for(g=numGroups;g>0;g--)
+        groupStart[g] = groupStart[g - 1];
+
+    groupStart[0] = 0;
 }
 
-/* Print the greatest set of anagram.*/
-void printGreatestSet(){
+/**********************************************************************************************************************************************/
+/*Parallel grouping*/
 
-    int i,j;
-    int cont    = 1;
-    Slot *slot  = H->slot;
+/*  With -t N the grouping runs on N threads. The text is cut into N chunks of bytes and every phase below is split between
+    the threads, with a barrier in between. The few steps that need all the threads' results (prefix sums and allocations)
+    are run by thread 0 alone between two barriers.
 
-    for(i=0;i<H->size;i++){
+    1) Each thread counts the words that start in its chunk. Thread 0 gives every chunk its range in buffer.
+    2) Each thread tokenizes and signs its chunk and counts how many of its words fall in each shard. The shard of a word is
+       given by the high half of its hash, so the tables never see the same signature twice. Thread 0 gives every
+       (shard, chunk) pair its range in order, in the order of the file.
+    3) Each thread copies the positions of its words into order, shard by shard.
+    4) Each shard has its own table and is grouped by one thread, reading its words from order (in the order of the file).
+    5) The groups get their final numbers in order of first appearance: each thread counts the groups whose first word is in
+       its chunk, thread 0 sums them up, and then each thread numbers its groups and turns groupOf into the final numbers.
+    6) Thread 0 computes the offsets of the groups and each thread lays out the groups of its shards.
 
-        if(slot[i].sizeSet == greaterSet){
+    The groups, their order and the order of their words are the same as in the serial version.*/
 
-            printf("\n\n%d - Set of anagrams :\n", cont++);
+#include <pthread.h>
 
-            for(j=0;j<greaterSet;j++){
+#define SHARDS      64
 
-                int position = slot[i].setOfAnagrams[j];
-                printf("%d: %s\n", j+1, buffer[position].string);
-            }
+int numThreads = 1;         /* 0 means one thread per processor.*/
+
+typedef struct{
+    int id;
+    uint64_t textBegin;     /* its chunk of text.*/
+    uint64_t textEnd;
+    int wordBegin;          /* the words that start in its chunk, in buffer.*/
+    int wordEnd;
+    int shardCount[SHARDS]; /* words of each shard in its chunk, then where they go in order.*/
+    int firsts;             /* groups first seen in its chunk, then the number of the first of them.*/
+}Worker;
+
+Worker            *worker;
+pthread_barrier_t barrier;
+Hash              shard[SHARDS];
+int               *globalOf[SHARDS];    /* final number of each group of a shard.*/
+int               shardStart[SHARDS + 1];
+Signature         *sigOf    = NULL;
+uint64_t          *hashOf   = NULL;
+int               *order    = NULL;     /* positions of the words, shard by shard.*/
+int               *cursor   = NULL;     /* where the next word of each group goes in members.*/
+
+static inline int shardOf(uint64_t h){
+
+    return (h >> 32) & (SHARDS - 1);
+}
+
+/* Run step on thread 0 once every thread got here, and let them go on when it is done.*/
+void together(Worker *w, void (*step)(void)){
+
+    pthread_barrier_wait(&barrier);
+
+    if(w->id == 0)
+        step();
+
+    pthread_barrier_wait(&barrier);
+}
+
+void allocWords(){
+
+    int t;
+
+    size = 0;
+
+    for(t=0;t<numThreads;t++){
+
+        worker[t].wordBegin = size;
+        size               += worker[t].wordEnd;
+        worker[t].wordEnd   = size;
+    }
+
+    buffer     = (Word*)malloc((size + 1)*sizeof(Word));
+    sigOf      = (Signature*)malloc((size + 1)*sizeof(Signature));
+    hashOf     = (uint64_t*)malloc((size + 1)*sizeof(uint64_t));
+    order      = (int*)malloc((size + 1)*sizeof(int));
+    groupOf    = (int*)malloc((size + 1)*sizeof(int));
+    members    = (int*)malloc((size + 1)*sizeof(int));
+}
+
+void placeShards(){
+
+    int s, t, total = 0;
+
+    for(s=0;s<SHARDS;s++){
+
+        shardStart[s] = total;
+
+        for(t=0;t<numThreads;t++){
+
+            int count                = worker[t].shardCount[s];
+            worker[t].shardCount[s]  = total;
+            total                   += count;
         }
     }
 
+    shardStart[SHARDS] = total;
 }
 
-char nameFile[30];
+void numberGroups(){
+
+    int s, t;
+
+    numGroups = 0;
+
+    for(t=0;t<numThreads;t++){
+
+        int count        = worker[t].firsts;
+        worker[t].firsts = numGroups;
+        numGroups       += count;
+    }
+
+    for(s=0;s<SHARDS;s++)
+        globalOf[s] = (int*)malloc((shard[s].numGroups + 1)*sizeof(int));
+
+    groupStart = (int*)calloc(numGroups + 2, sizeof(int));
+    cursor     = (int*)malloc((numGroups + 1)*sizeof(int));
+}
+
+void copyOffsets(){
+
+    groupOffsets();
+    memcpy(cursor, groupStart, numGroups*sizeof(int));
+}
+
+void *groupWords(void *arg){
+
+    Worker *w = (Worker*)arg;
+    int    i, k, s;
+
+    /* 1) Count the words of the chunk.*/
+    w->wordEnd = tokenize(w->textBegin, w->textEnd, NULL);
+
+    together(w, allocWords);
+
+    /* 2) Tokenize, sign and count the shards. Thread 0 times its part of the signing for -json.*/
+    tokenize(w->textBegin, w->textEnd, buffer + w->wordBegin);
 
-int main(){
+    if(w->id == 0 AND instrument)
+        signTime = now();
 
-    printf("Write the name of the file: ");
+    for(i=w->wordBegin;i<w->wordEnd;i+=BATCH){
 
-    scanf("%s",nameFile);
+        int count = (w->wordEnd - i < BATCH) ? w->wordEnd - i : BATCH;
+
+        signWords(i, count, sigOf + i);
+
+        for(k=i;k<i+count;k++){
+
+            hashOf[k] = hashSignature(sigOf[k]);
+            ++w->shardCount[shardOf(hashOf[k])];
+        }
+    }
+
+    if(w->id == 0 AND instrument)
+        signTime = now() - signTime;
+
+    together(w, placeShards);
+
+    /* 3) Scatter the positions by shard.*/
+    for(i=w->wordBegin;i<w->wordEnd;i++)
+        order[w->shardCount[shardOf(hashOf[i])]++] = i;
+
+    pthread_barrier_wait(&barrier);
+
+    /* 4) Group each shard.*/
+    for(s=w->id;s<SHARDS;s+=numThreads){
+
+        createTable(&shard[s]);
+
+        for(k=shardStart[s];k<shardStart[s + 1];k++){
+
+            if(k + PREFETCH < shardStart[s + 1])
+                prefetchHash(&shard[s], hashOf[order[k + PREFETCH]]);
+
+            i          = order[k];
+            groupOf[i] = insertHash(&shard[s], sigOf[i], hashOf[i], i);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    /* 5) Number the groups in order of first appearance.*/
+    w->firsts = 0;
+
+    for(i=w->wordBegin;i<w->wordEnd;i++)
+        if(shard[shardOf(hashOf[i])].first[groupOf[i]] == i)
+            ++w->firsts;
+
+    together(w, numberGroups);
+
+    for(i=w->wordBegin;i<w->wordEnd;i++){
+
+        Hash *T = &shard[shardOf(hashOf[i])];
+        int  g  = groupOf[i];
+
+        if(T->first[g] == i){
+
+            globalOf[shardOf(hashOf[i])][g] = w->firsts;
+            groupStart[w->firsts + 1]       = T->count[g];
+            ++w->firsts;
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    for(i=w->wordBegin;i<w->wordEnd;i++)
+        groupOf[i] = globalOf[shardOf(hashOf[i])][groupOf[i]];
+
+    together(w, copyOffsets);
+
+    /* 6) Lay out the groups of each shard. A group lives in one shard, so no two threads write to the same group.*/
+    for(s=w->id;s<SHARDS;s+=numThreads)
+        for(k=shardStart[s];k<shardStart[s + 1];k++)
+            members[cursor[groupOf[order[k]]]++] = order[k];
+
+    return NULL;
+}
+
+void parallelGroups(){
+
+    pthread_t *thread;
+    double    t = instrument ? now() : 0;
+    int       i;
+
+    initSignature();
+
+    worker    = (Worker*)calloc(numThreads, sizeof(Worker));
+    thread    = (pthread_t*)malloc(numThreads*sizeof(pthread_t));
+    tables    = shard;
+    numTables = SHARDS;
+
+    pthread_barrier_init(&barrier, NULL, numThreads);
+
+    for(i=0;i<numThreads;i++){
+
+        worker[i].id        = i;
+        worker[i].textBegin = textSize*i/numThreads;
+        worker[i].textEnd   = textSize*(i + 1)/numThreads;
+        pthread_create(&thread[i], NULL, groupWords, &worker[i]);
+    }
+
+    for(i=0;i<numThreads;i++)
+        pthread_join(thread[i], NULL);
+
+    pthread_barrier_destroy(&barrier);
+    free(thread);
+
+    if(instrument)
+        groupTime = now() - t - signTime;
+}
+
+/**********************************************************************************************************************************************/
+/*Sort-based grouping*/
+
+/*  The other engine (-e sort): no hash table at all. Every word becomes a pair (signature, position), the pairs are sorted
+    by signature with an LSD radix sort and the anagrams end up next to each other. The sort is stable and the pairs start
+    in the order of the file, so inside a run the words stay in that order.
+
+    The signature is cut into 12 digits of 11 bits (2048 buckets, so the counters stay in L1). The counts of all the digits
+    are taken in one read of the keys, and a digit that is the same for every word is skipped. The memory is fixed:
+    two arrays of keys and two of positions, 40 bytes per word.*/
+#define DIGIT_BITS  11
+#define DIGITS      12
+#define BUCKETS     (1 << DIGIT_BITS)
+
+int sortPasses = 0;         /* digits that really needed a pass, printed with -stats.*/
+
+static inline int digitOf(Signature sig, int d){
+
+    return (int)(sig >> (d*DIGIT_BITS)) & (BUCKETS - 1);
+}
+
+/* Sort key[0..size-1] and position[] along with it. The result is in key and position.*/
+void radixSort(Signature *key, int *position){
+
+    Signature *key2      = (Signature*)malloc((size + 1)*sizeof(Signature));
+    int       *position2 = (int*)malloc((size + 1)*sizeof(int));
+    int       (*count)[BUCKETS] = calloc(DIGITS, sizeof(*count));
+    Signature *fromKey = key, *toKey = key2, *swapKey;
+    int       *from    = position, *to = position2, *swap;
+    int       i, d;
+
+    for(i=0;i<size;i++)
+        for(d=0;d<DIGITS;d++)
+            ++count[d][digitOf(key[i], d)];
+
+    for(d=0;d<DIGITS;d++){
+
+        int b, total = 0;
+
+        /* Every word has the same digit here: nothing to do.*/
+        if(count[d][digitOf(key[0], d)] == size)
+            continue;
+
+        for(b=0;b<BUCKETS;b++){
+
+            int c       = count[d][b];
+            count[d][b] = total;
+            total      += c;
+        }
+
+        for(i=0;i<size;i++){
+
+            int k = count[d][digitOf(fromKey[i], d)]++;
+
+            toKey[k] = fromKey[i];
+            to[k]    = from[i];
+        }
+
+        /* The two buffers take turns, instead of copying the pass back every time.*/
+        swapKey = fromKey;  fromKey = toKey;  toKey = swapKey;
+        swap    = from;     from    = to;     to    = swap;
+        ++sortPasses;
+    }
+
+    if(fromKey != key){
+
+        memcpy(key, fromKey, size*sizeof(Signature));
+        memcpy(position, from, size*sizeof(int));
+    }
+
+    free(key2);
+    free(position2);
+    free(count);
+}
+
+/*  Split a run of equal SPILLED signatures into sets of real anagrams. Returns the next free run number.
+    Each word is compared with the first word of every set of the run, but SPILLED signatures are signed by all their bytes,
+    so a run is almost always a single set and this is linear.*/
+int splitSpilled(int *position, int length, int run, int *runFirst){
+
+    int i, j, open = run;
+
+    for(i=0;i<length;i++){
+
+        int p = position[i];
+
+        for(j=open;j<run;j++)
+            if(sameLetters(&buffer[runFirst[j]], &buffer[p]))
+                break;
+
+        if(j == run)
+            runFirst[run++] = p;
+
+        groupOf[p] = j;
+    }
+
+    return run;
+}
+
+/* Group the words by sorting: every run of equal signatures is a set. Then number the sets in order of first appearance.*/
+void sortGroups(){
+
+    Signature *key      = (Signature*)malloc((size + 1)*sizeof(Signature));
+    int       *position = (int*)malloc((size + 1)*sizeof(int));
+    int       *runFirst = (int*)malloc((size + 1)*sizeof(int));
+    int       i, j, run = 0;
+    double    t = instrument ? now() : 0;
+
+    initSignature();
+
+    for(i=0;i<size;i+=BATCH)
+        signWords(i, (size - i < BATCH) ? size - i : BATCH, key + i);
+
+    if(instrument){
+
+        signTime = now() - t;
+        t        = now();
+    }
+
+    for(i=0;i<size;i++)
+        position[i] = i;
+
+    if(size > 0)
+        radixSort(key, position);
+
+    groupOf    = (int*)malloc((size + 1)*sizeof(int));
+    groupStart = (int*)calloc(size + 2, sizeof(int));
+    members    = (int*)malloc((size + 1)*sizeof(int));
+
+    for(i=0;i<size;i=j){
+
+        for(j=i+1;j<size AND key[j] == key[i];j++);
+
+        if(key[i] & SPILLED)
+            run = splitSpilled(position + i, j - i, run, runFirst);
+        else{
+
+            int k;
+
+            runFirst[run] = position[i];
+
+            for(k=i;k<j;k++)
+                groupOf[position[k]] = run;
+
+            ++run;
+        }
+    }
+
+    /* runFirst is reused as the final number of each run.*/
+    numGroups = 0;
+
+    for(i=0;i<size;i++)
+        if(runFirst[groupOf[i]] == i)
+            runFirst[groupOf[i]] = -1 - numGroups++;
+
+    for(i=0;i<size;i++){
+
+        groupOf[i] = -1 - runFirst[groupOf[i]];
+        ++groupStart[groupOf[i] + 1];
+    }
+
+    free(key);
+    free(position);
+    free(runFirst);
+
+    if(instrument)
+        groupTime = now() - t;
+}
+
+/**********************************************************************************************************************************************/
+/*Anagram index file*/
+
+/*  With -save file the groups are written to an index, and later runs with -load file map it and answer queries
+    ("all the anagrams of this word") without reading the dictionary again.
+
+    The file is an IndexHeader followed by these arrays, each one starting at a multiple of 64 bytes:
+    ctrl, key, slotGroup    a Swiss table (as above) from signature to group, at most 7/8 full.
+    groupStart, members     the groups, as in the CSR arrays above.
+    wordStart, words        the words, one after another, word i is words[wordStart[i]] ... words[wordStart[i+1] - 1].
+    There are only offsets in it, so it can be mapped anywhere. A query signs the word and probes the table: a block of 16
+    control bytes and usually one key, which is one or two cache lines.*/
+
+#define INDEX_MAGIC 0x32584941  /* "AIX2" */
+
+typedef struct{
+    uint32_t magic;
+    int32_t  numWords;
+    int32_t  numGroups;
+    int32_t  greaterSet;
+    uint64_t capacity;
+    uint64_t ctrlOffset, keyOffset, slotOffset, startOffset, memberOffset, wordStartOffset, wordsOffset, fileSize;
+}IndexHeader;
+
+IndexHeader   *indexHeader  = NULL;
+unsigned char *indexCtrl;
+Signature     *indexKey;
+int32_t       *indexSlot;
+int32_t       *indexStart;
+int32_t       *indexMembers;
+uint64_t      *indexWordStart;
+char          *indexWords;
+
+size_t align64(size_t value){
+
+    return (value + 63) & ~(size_t)63;
+}
+
+void indexLayout(IndexHeader *h, uint64_t capacity, uint64_t letters){
+
+    h->magic           = INDEX_MAGIC;
+    h->numWords        = size;
+    h->numGroups       = numGroups;
+    h->greaterSet      = greaterSet;
+    h->capacity        = capacity;
+    h->ctrlOffset      = align64(sizeof(IndexHeader));
+    h->keyOffset       = align64(h->ctrlOffset + capacity);
+    h->slotOffset      = align64(h->keyOffset + capacity*sizeof(Signature));
+    h->startOffset     = align64(h->slotOffset + capacity*sizeof(int32_t));
+    h->memberOffset    = align64(h->startOffset + ((uint64_t)numGroups + 1)*sizeof(int32_t));
+    h->wordStartOffset = align64(h->memberOffset + (uint64_t)size*sizeof(int32_t));
+    h->wordsOffset     = align64(h->wordStartOffset + ((uint64_t)size + 1)*sizeof(uint64_t));
+    h->fileSize        = h->wordsOffset + letters;
+}
+
+void writeAt(FILE *fp, uint64_t offset, void *data, size_t bytes){
+
+    fseeko(fp, (off_t)offset, SEEK_SET);
+    fwrite(data, 1, bytes, fp);
+}
+
+void saveIndex(char *fileName){
+
+    IndexHeader h;
+    Hash        T;
+    uint64_t    capacity = BLOCK;
+    uint64_t    *wordStart = (uint64_t*)malloc(((uint64_t)size + 1)*sizeof(uint64_t));
+    FILE        *fp = fopen(fileName, "wb");
+    int         g, i;
+
+    if(fp == NULL){
+
+        printf("Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    /* A new table, sized for the groups, with one slot per group.*/
+    while(capacity - capacity/8 < (uint64_t)numGroups)
+        capacity *= 2;
+
+    memset(&T, 0, sizeof(Hash));
+    allocTable(&T, capacity);
+
+    for(g=0;g<numGroups;g++){
+
+        Word     *w = &buffer[members[groupStart[g]]];
+        Signature sig = sign(text + w->offset, w->length);
+        uint64_t  h   = hashSignature(sig);
+        uint64_t  k   = freeSlot(&T, h);
+
+        T.ctrl[k]  = h >> 57;
+        T.key[k]   = sig;
+        T.group[k] = g;
+    }
+
+    wordStart[0] = 0;
+
+    for(i=0;i<size;i++)
+        wordStart[i + 1] = wordStart[i] + buffer[i].length;
+
+    indexLayout(&h, capacity, wordStart[size]);
+
+    writeAt(fp, 0, &h, sizeof(IndexHeader));
+    writeAt(fp, h.ctrlOffset, T.ctrl, capacity);
+    writeAt(fp, h.keyOffset, T.key, capacity*sizeof(Signature));
+    writeAt(fp, h.slotOffset, T.group, capacity*sizeof(int32_t));
+    writeAt(fp, h.startOffset, groupStart, ((uint64_t)numGroups + 1)*sizeof(int32_t));
+    writeAt(fp, h.memberOffset, members, (uint64_t)size*sizeof(int32_t));
+    writeAt(fp, h.wordStartOffset, wordStart, ((uint64_t)size + 1)*sizeof(uint64_t));
+
+    fseeko(fp, (off_t)h.wordsOffset, SEEK_SET);
+
+    for(i=0;i<size;i++)
+        fwrite(text + buffer[i].offset, 1, buffer[i].length, fp);
+
+    /* The last arrays may be empty, and seeking does not make the file longer.*/
+    fflush(fp);
+    if(ftruncate(fileno(fp), (off_t)h.fileSize) != 0)
+        printf("Could not write %s\n", fileName);
+
+    fclose(fp);
+
+    free(T.ctrl);  free(T.key);  free(T.group);
+    free(T.first); free(T.count);
+    free(wordStart);
+}
+
+/* Map an index. Nothing is read until a query touches it.*/
+void loadIndex(char *fileName){
+
+    struct stat st;
+    char        *base;
+    int         fd = open(fileName, O_RDONLY);
+
+    if(fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)){
+
+        printf("Could not open %s\n", fileName);
+        exit(1);
+    }
+
+    base = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    indexHeader = (IndexHeader*)base;
+
+    if(base == MAP_FAILED || indexHeader->magic != INDEX_MAGIC || indexHeader->fileSize != (uint64_t)st.st_size){
+
+        printf("%s is not an anagram index\n", fileName);
+        exit(1);
+    }
+
+    indexCtrl      = (unsigned char*)(base + indexHeader->ctrlOffset);
+    indexKey       = (Signature*)(base + indexHeader->keyOffset);
+    indexSlot      = (int32_t*)(base + indexHeader->slotOffset);
+    indexStart     = (int32_t*)(base + indexHeader->startOffset);
+    indexMembers   = (int32_t*)(base + indexHeader->memberOffset);
+    indexWordStart = (uint64_t*)(base + indexHeader->wordStartOffset);
+    indexWords     = base + indexHeader->wordsOffset;
+
+    initSignature();
+}
+
+/* The group of the anagrams of word in the index, or -1 if there is none.*/
+int lookupWord(char *word, uint32_t length){
+
+    Signature     sig       = sign(word, length);
+    uint64_t      h         = hashSignature(sig);
+    unsigned char tag       = h >> 57;
+    uint64_t      blockMask = indexHeader->capacity/BLOCK - 1;
+    uint64_t      block     = h & blockMask;
+    int           step      = 0;
+
+    while(TRUE){
+
+        unsigned char *ctrl = indexCtrl + block*BLOCK;
+        int           mask  = matchTag(ctrl, tag);
+
+        while(mask){
+
+            uint64_t k = block*BLOCK + __builtin_ctz(mask);
+            int      g = indexSlot[k];
+
+            if(indexKey[k] == sig){
+
+                int first = indexMembers[indexStart[g]];
+
+                if(!(sig & SPILLED) || sameBytes(indexWords + indexWordStart[first],
+                                                 (uint32_t)(indexWordStart[first + 1] - indexWordStart[first]), word, length))
+                    return g;
+            }
+
+            mask &= mask - 1;
+        }
+
+        if(matchTag(ctrl, EMPTY_TAG))
+            return -1;
+
+        ++step;
+        block = (block + step) & blockMask;
+    }
+}
+
+/* Find the next word of a line read by getline, starting at *begin: it is line[*begin] ... line[*end - 1].
+   Returns FALSE if there are only blanks left.*/
+int nextToken(char *line, ssize_t length, ssize_t *begin, ssize_t *end){
+
+    while(*begin < length AND BLANK(line[*begin]))
+        ++*begin;
+
+    if(*begin == length)
+        return FALSE;
+
+    for(*end=*begin; *end < length AND !BLANK(line[*end]); ++*end);
+
+    return TRUE;
+}
+
+/* Answer every word of the queries (one or more per line) with "word: its anagrams".*/
+void answerQueries(FILE *fp){
+
+    char    *line     = NULL;
+    size_t  capacity  = 0;
+    ssize_t length;
+
+    while((length = getline(&line, &capacity, fp)) > 0){
+
+        ssize_t begin = 0, end;
+
+        while(nextToken(line, length, &begin, &end)){
+
+            int g, j;
+
+            printf("%.*s:", (int)(end - begin), line + begin);
+
+            g = lookupWord(line + begin, (uint32_t)(end - begin));
+
+            if(g >= 0){
+
+                for(j=indexStart[g];j<indexStart[g + 1];j++){
+
+                    int w = indexMembers[j];
+                    printf(" %.*s", (int)(indexWordStart[w + 1] - indexWordStart[w]), indexWords + indexWordStart[w]);
+                }
+            }
+
+            printf("\n");
+            begin = end;
+        }
+    }
+
+    free(line);
+}
+
+/**********************************************************************************************************************************************/
+/*Sub-anagrams*/
+
+/*  With -r file, each word of the file is a rack of letters and the program prints every word of the dictionary that can be
+    built with them (each letter of the rack used at most once). A word fits in a rack when none of its letter counts is
+    bigger, so this works on the groups, not on the words: all the words of a group fit or none does.
+
+    Every group gets a histogram of 32 bytes (the 26 counts, saturated at 255, and zeros) and a mask of the letters it has,
+    plus bit OTHER if it has something that is not a letter (those never fit). The groups are sorted by mask, so the groups
+    with one mask are together. A query only looks at masks inside the rack's mask:
+    - if the rack has few different letters, it walks the submasks of its mask and finds them in a small hash table;
+    - otherwise it reads the list of masks (a few bytes each) and skips the ones with a letter that is not in the rack.
+    The histograms of the groups left are compared 16 counts at a time: max(word, rack) == rack for every byte.*/
+
+#define HISTOGRAM   32
+
+typedef struct{
+    int      numMasks;
+    uint32_t *mask;         /* the different masks, sorted.*/
+    int      *maskStart;    /* the groups of mask[i] are sortedGroup[maskStart[i]] ... sortedGroup[maskStart[i+1] - 1].*/
+    int      *sortedGroup;
+    unsigned char *histogram; /* HISTOGRAM bytes per entry of sortedGroup.*/
+    uint32_t capacity;      /* the table from mask to its position in mask, a power of two.*/
+    uint32_t *tableMask;
+    int      *tableSlot;    /* -1 if free.*/
+}SubIndex;
+
+SubIndex sub;
+int      *matched = NULL;   /* groups found by the current query.*/
+
+typedef struct{
+    uint32_t mask;
+    int      group;
+}MaskedGroup;
+
+int compareMasked(const void *a, const void *b){
+
+    const MaskedGroup *x = (const MaskedGroup*)a;
+    const MaskedGroup *y = (const MaskedGroup*)b;
+
+    if(x->mask != y->mask)
+        return x->mask < y->mask ? -1 : 1;
+
+    return x->group - y->group;
+}
+
+static inline uint32_t hashMask(uint32_t mask){
+
+    return (uint32_t)((mask * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/* Fill a histogram of a word (or a rack) and return its mask.*/
+uint32_t letterHistogram(char *word, uint32_t length, unsigned char *histogram){
+
+    uint32_t count[OTHER + 1] = {0};
+    uint32_t mask             = 0;
+    uint32_t i;
+
+    for(i=0;i<length;i++)
+        ++count[letterOf[(unsigned char)word[i]]];
+
+    memset(histogram, 0, HISTOGRAM);
+
+    for(i=0;i<=OTHER;i++){
+
+        if(count[i] > 0)
+            mask |= 1u << i;
+
+        if(i < OTHER)
+            histogram[i] = count[i] > 255 ? 255 : count[i];
+    }
+
+    return mask;
+}
+
+void buildSubIndex(){
+
+    MaskedGroup   *list = (MaskedGroup*)malloc((numGroups + 1)*sizeof(MaskedGroup));
+    unsigned char scratch[HISTOGRAM];
+    int           g, i;
+
+    initSignature();
+
+    sub.sortedGroup = (int*)malloc((numGroups + 1)*sizeof(int));
+    sub.histogram   = (unsigned char*)aligned_alloc(64, align64(((size_t)numGroups + 1)*HISTOGRAM));
+    sub.mask        = (uint32_t*)malloc((numGroups + 1)*sizeof(uint32_t));
+    sub.maskStart   = (int*)malloc((numGroups + 2)*sizeof(int));
+    sub.numMasks    = 0;
+    matched         = (int*)malloc((numGroups + 1)*sizeof(int));
+
+    for(g=0;g<numGroups;g++){
+
+        Word *w = &buffer[members[groupStart[g]]];
+
+        list[g].mask  = letterHistogram(text + w->offset, w->length, scratch);
+        list[g].group = g;
+    }
+
+    qsort(list, numGroups, sizeof(MaskedGroup), compareMasked);
+
+    for(i=0;i<numGroups;i++){
+
+        Word *w = &buffer[members[groupStart[list[i].group]]];
+
+        if(i == 0 || list[i].mask != list[i - 1].mask){
+
+            sub.mask[sub.numMasks]      = list[i].mask;
+            sub.maskStart[sub.numMasks] = i;
+            ++sub.numMasks;
+        }
+
+        sub.sortedGroup[i] = list[i].group;
+        letterHistogram(text + w->offset, w->length, sub.histogram + (size_t)i*HISTOGRAM);
+    }
+
+    sub.maskStart[sub.numMasks] = numGroups;
+
+    /* The table from mask to position, at most half full.*/
+    sub.capacity = 16;
+
+    while(sub.capacity < 2*(uint32_t)sub.numMasks)
+        sub.capacity *= 2;
+
+    sub.tableMask = (uint32_t*)malloc(sub.capacity*sizeof(uint32_t));
+    sub.tableSlot = (int*)malloc(sub.capacity*sizeof(int));
+
+    for(i=0;i<(int)sub.capacity;i++)
+        sub.tableSlot[i] = -1;
+
+    for(i=0;i<sub.numMasks;i++){
+
+        uint32_t k = hashMask(sub.mask[i]) & (sub.capacity - 1);
+
+        while(sub.tableSlot[k] != -1)
+            k = (k + 1) & (sub.capacity - 1);
+
+        sub.tableMask[k] = sub.mask[i];
+        sub.tableSlot[k] = i;
+    }
+
+    free(list);
+}
+
+/* Position of mask in sub.mask, or -1.*/
+int findMask(uint32_t mask){
+
+    uint32_t k = hashMask(mask) & (sub.capacity - 1);
+
+    while(sub.tableSlot[k] != -1){
+
+        if(sub.tableMask[k] == mask)
+            return sub.tableSlot[k];
+
+        k = (k + 1) & (sub.capacity - 1);
+    }
+
+    return -1;
+}
+
+/* TRUE if every count of the histogram is at most the rack's.*/
+static inline int fits(unsigned char *histogram, unsigned char *rack){
+
+#ifdef __SSE2__
+    __m128i r0 = _mm_loadu_si128((__m128i*)rack);
+    __m128i r1 = _mm_loadu_si128((__m128i*)(rack + 16));
+    __m128i h0 = _mm_load_si128((__m128i*)histogram);
+    __m128i h1 = _mm_load_si128((__m128i*)(histogram + 16));
+    __m128i ok = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(h0, r0), r0), _mm_cmpeq_epi8(_mm_max_epu8(h1, r1), r1));
+
+    return _mm_movemask_epi8(ok) == 0xFFFF;
+#else
+    int i;
+
+    for(i=0;i<OTHER;i++)
+        if(histogram[i] > rack[i])
+            return FALSE;
+
+    return TRUE;
+#endif
+}
+
+/* Check the groups of one mask against the rack. Returns the new number of matched groups.*/
+int matchMask(int i, unsigned char *rack, int found){
+
+    int k;
+
+    for(k=sub.maskStart[i];k<sub.maskStart[i + 1];k++)
+        if(fits(sub.histogram + (size_t)k*HISTOGRAM, rack))
+            matched[found++] = sub.sortedGroup[k];
+
+    return found;
+}
+
+int compareInt(const void *a, const void *b){
+
+    return *(const int*)a - *(const int*)b;
+}
+
+/* Find the groups of the words that can be built from the rack, in order of first appearance. Returns how many.*/
+int subAnagrams(char *word, uint32_t length){
+
+    unsigned char rack[HISTOGRAM];
+    uint32_t      rackMask = letterHistogram(word, length, rack);
+    int           found    = 0;
+    int           i;
+
+    /* A non-letter in the rack is just ignored.*/
+    rackMask &= ~(1u << OTHER);
+
+    if(((uint64_t)1 << __builtin_popcount(rackMask)) <= (uint64_t)sub.numMasks){
+
+        uint32_t s = rackMask;
+
+        /* Every nonempty submask of rackMask, from the largest down.*/
+        while(s != 0){
+
+            if((i = findMask(s)) >= 0)
+                found = matchMask(i, rack, found);
+
+            s = (s - 1) & rackMask;
+        }
+    }else{
+
+        for(i=0;i<sub.numMasks;i++)
+            if((sub.mask[i] & ~rackMask) == 0)
+                found = matchMask(i, rack, found);
+    }
+
+    qsort(matched, found, sizeof(int), compareInt);
+
+    return found;
+}
+
+/* Answer every rack of the file with "rack: words".*/
+void answerRacks(FILE *fp){
+
+    char    *line     = NULL;
+    size_t  capacity  = 0;
+    ssize_t length;
+
+    buildSubIndex();
+
+    while((length = getline(&line, &capacity, fp)) > 0){
+
+        ssize_t begin = 0, end;
+
+        while(nextToken(line, length, &begin, &end)){
+
+            int found, i, j;
+
+            printf("%.*s:", (int)(end - begin), line + begin);
+
+            found = subAnagrams(line + begin, (uint32_t)(end - begin));
+
+            for(i=0;i<found;i++){
+
+                for(j=groupStart[matched[i]];j<groupStart[matched[i] + 1];j++){
+
+                    Word *w = &buffer[members[j]];
+                    printf(" %.*s", (int)w->length, text + w->offset);
+                }
+            }
+
+            printf("\n");
+            begin = end;
+        }
+    }
+
+    free(line);
+}
+
+/**********************************************************************************************************************************************/
+/*Streaming top-K*/
+
+/*  With -stream the words are read as they come (from a pipe, for example) and never kept. The program counts the words of
+    each set of anagrams and every -every N words prints the K greatest sets so far (-k K), then goes on reading.
+    The memory is limited to -m MB:
+
+    1) While it fits, the counts are exact. The sets are kept in the same hash table as above; the vector buffer only has
+       one word of each set (its example) and text is a growing copy of those words, so buffer and text work as usual.
+    2) When the table, the examples and buffer need more than the budget, the program keeps only the greatest sets that fit
+       in a fixed array and goes on with Space-Saving: a word of a set that is not in the array takes the place of the
+       smallest count c, starting at c + 1 with an error of c. Every count is then at most error too high, and a set with
+       more than (words read)/(size of the array) words is always in the array. The smallest count is kept at the top of
+       a heap, and a small hash table finds a set in the array. Here SPILLED signatures are only compared by signature:
+       they are signed by all their bytes, so two sets share one only if their 127-bit sums collide.*/
+
+#define STREAM_CHUNK    (1 << 16)
+#define SKETCH_BYTES    128     /* memory of one set in the Space-Saving array, with its example, table and heap.*/
+
+typedef struct{
+    Signature sig;
+    uint64_t  count;
+    uint64_t  error;        /* how much count may be too high.*/
+    char      *example;
+    uint32_t  length;
+    int       heapPos;
+}Counter;
+
+int       topK          = 10;
+uint64_t  every         = 1000000;
+uint64_t  budget        = 256 << 20;
+uint64_t  wordsSeen     = 0;
+uint64_t  textCapacity  = 0;
+int       bufferCapacity = 0;
+int       sketching     = FALSE;
+
+Counter   *counter      = NULL;
+int       numCounters   = 0;
+int       maxCounters   = 0;
+int       *heap         = NULL;     /* counters by count, the smallest at heap[0].*/
+int       *where        = NULL;     /* table from signature to counter, -1 if free.*/
+uint32_t  whereMask     = 0;
+
+uint64_t exactMemory(){
+
+    return H->capacity*(1 + sizeof(Signature) + 3*sizeof(int)) + textCapacity + (uint64_t)bufferCapacity*sizeof(Word);
+}
+
+/* Count one word in the exact table. The word is put at the end of text as buffer[size], and kept only if its set is new.*/
+void countExact(char *word, uint32_t length, Signature sig){
+
+    int groups = H->numGroups;
+
+    if(textSize + length > textCapacity){
+
+        textCapacity = 2*(textSize + length) + STREAM_CHUNK;
+        text         = (char*)realloc(text, textCapacity);
+    }
+
+    if(size + 1 > bufferCapacity){
+
+        bufferCapacity = 2*bufferCapacity + 1024;
+        buffer         = (Word*)realloc(buffer, bufferCapacity*sizeof(Word));
+    }
+
+    memcpy(text + textSize, word, length);
+    buffer[size].offset = textSize;
+    buffer[size].length = length;
+
+    insertHash(H, sig, hashSignature(sig), size);
+
+    if(H->numGroups > groups){
+
+        textSize += length;
+        ++size;
+    }
+}
+
+/* The heap is ordered by count: a parent is never greater than its children.*/
+void siftDown(int i){
+
+    int c;
+
+    while(TRUE){
+
+        int smallest = i;
+        int left     = 2*i + 1;
+        int right    = 2*i + 2;
+
+        if(left < numCounters AND counter[heap[left]].count < counter[heap[smallest]].count)
+            smallest = left;
+        if(right < numCounters AND counter[heap[right]].count < counter[heap[smallest]].count)
+            smallest = right;
+
+        if(smallest == i)
+            return;
+
+        c              = heap[i];
+        heap[i]        = heap[smallest];
+        heap[smallest] = c;
+
+        counter[heap[i]].heapPos        = i;
+        counter[heap[smallest]].heapPos = smallest;
+        i = smallest;
+    }
+}
+
+/* Position of sig in where: its slot, or the free slot where it would go.*/
+uint32_t findCounter(Signature sig){
+
+    uint32_t k = hashSignature(sig) & whereMask;
+
+    while(where[k] != -1 AND counter[where[k]].sig != sig)
+        k = (k + 1) & whereMask;
+
+    return k;
+}
+
+/* Take sig out of where. The slots after it are moved back, so no search stops too early (linear probing).*/
+void removeCounter(Signature sig){
+
+    uint32_t hole = findCounter(sig);
+    uint32_t k    = hole;
+
+    where[hole] = -1;
+
+    while(TRUE){
+
+        uint32_t home;
+
+        k = (k + 1) & whereMask;
+
+        if(where[k] == -1)
+            return;
+
+        home = hashSignature(counter[where[k]].sig) & whereMask;
+
+        /* The entry at k can fill the hole if its home is not between the hole and k.*/
+        if(((k - home) & whereMask) >= ((k - hole) & whereMask)){
+
+            where[hole] = where[k];
+            where[k]    = -1;
+            hole        = k;
+        }
+    }
+}
+
+int compareGroupCount(const void *a, const void *b){
+
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+
+    if(H->count[x] != H->count[y])
+        return H->count[x] > H->count[y] ? -1 : 1;
+
+    return x - y;
+}
+
+/* Going from 1) to 2): keep the greatest sets in the Space-Saving array and free the exact table.*/
+void startSketch(){
+
+    int      *order   = (int*)malloc((H->numGroups + 1)*sizeof(int));
+    int      capacity = (int)(budget/SKETCH_BYTES);
+    uint32_t tableSize = 16;
+    int      g, i;
+
+    if(capacity < topK)
+        capacity = topK;
+
+    for(g=0;g<H->numGroups;g++)
+        order[g] = g;
+
+    qsort(order, H->numGroups, sizeof(int), compareGroupCount);
+
+    numCounters = H->numGroups < capacity ? H->numGroups : capacity;
+    counter     = (Counter*)malloc(capacity*sizeof(Counter));
+    heap        = (int*)malloc(capacity*sizeof(int));
+
+    while(tableSize < 2*(uint32_t)capacity)
+        tableSize *= 2;
+
+    where     = (int*)malloc(tableSize*sizeof(int));
+    whereMask = tableSize - 1;
+
+    for(i=0;i<(int)tableSize;i++)
+        where[i] = -1;
+
+    for(i=0;i<numCounters;i++){
+
+        Word *w = &buffer[H->first[order[i]]];
+
+        counter[i].sig     = sign(text + w->offset, w->length);
+        counter[i].count   = H->count[order[i]];
+        counter[i].error   = 0;
+        counter[i].length  = w->length;
+        counter[i].example = (char*)malloc(w->length + 1);
+        memcpy(counter[i].example, text + w->offset, w->length);
+
+        where[findCounter(counter[i].sig)] = i;
+    }
+
+    /* Sorted from the greatest, so reversed it is already a heap.*/
+    for(i=0;i<numCounters;i++){
+
+        heap[i]                = numCounters - 1 - i;
+        counter[heap[i]].heapPos = i;
+    }
+
+    /* From now on numCounters grows up to capacity before anything is replaced.*/
+    maxCounters = capacity;
+
+    free(H->ctrl); free(H->key); free(H->group); free(H->first); free(H->count);
+    free(text);    free(buffer); free(order);
+
+    text      = NULL;
+    buffer    = NULL;
+    textSize  = 0;
+    size      = 0;
+    sketching = TRUE;
+}
+
+/* Count one word in the Space-Saving array.*/
+void countSketch(char *word, uint32_t length, Signature sig){
+
+    uint32_t k = findCounter(sig);
+    int      c;
+
+    if(where[k] != -1){
+
+        c = where[k];
+        ++counter[c].count;
+        siftDown(counter[c].heapPos);
+        return;
+    }
+
+    /* A new set: a free place if there is one, otherwise the smallest count.*/
+    if(numCounters < maxCounters){
+
+        c                   = numCounters;
+        heap[numCounters]   = c;
+        counter[c].heapPos  = numCounters;
+        counter[c].count    = 0;
+        counter[c].example  = NULL;
+        ++numCounters;
+
+        /* It has the smallest count, 0, so it goes to the top.*/
+        while(counter[c].heapPos > 0){
+
+            int i      = counter[c].heapPos;
+            int parent = (i - 1)/2;
+
+            heap[i]                     = heap[parent];
+            counter[heap[i]].heapPos    = i;
+            heap[parent]                = c;
+            counter[c].heapPos          = parent;
+        }
+
+    }else{
+
+        c = heap[0];
+        removeCounter(counter[c].sig);
+        k = findCounter(sig);
+    }
+
+    counter[c].sig     = sig;
+    counter[c].error   = counter[c].count;
+    counter[c].count  += 1;
+    counter[c].length  = length;
+    counter[c].example = (char*)realloc(counter[c].example, length + 1);
+    memcpy(counter[c].example, word, length);
+
+    where[k] = c;
+    siftDown(counter[c].heapPos);
+}
+
+int compareCounter(const void *a, const void *b){
+
+    const Counter *x = &counter[*(const int*)a];
+    const Counter *y = &counter[*(const int*)b];
+
+    if(x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+
+    if(x->error != y->error)
+        return x->error < y->error ? -1 : 1;
+
+    return *(const int*)a - *(const int*)b;
+}
+
+/* Print the K greatest sets so far.*/
+void snapshot(){
+
+    int n = sketching ? numCounters : H->numGroups;
+    int *order = (int*)malloc((n + 1)*sizeof(int));
+    int i;
+
+    for(i=0;i<n;i++)
+        order[i] = i;
+
+    qsort(order, n, sizeof(int), sketching ? compareCounter : compareGroupCount);
+
+    printf("\nTop %d after %" PRIu64 " words (%s):\n", n < topK ? n : topK, wordsSeen, sketching ? "approximate" : "exact");
+
+    for(i=0;i<n AND i<topK;i++){
+
+        if(sketching){
+
+            Counter *c = &counter[order[i]];
+            printf("%d: %" PRIu64 " (at most %" PRIu64 " too high) %.*s\n", i+1, c->count, c->error, (int)c->length, c->example);
+        }else{
+
+            Word *w = &buffer[H->first[order[i]]];
+            printf("%d: %d %.*s\n", i+1, H->count[order[i]], (int)w->length, text + w->offset);
+        }
+    }
+
+    fflush(stdout);
+    free(order);
+}
+
+void countWord(char *word, uint32_t length){
+
+    Signature sig = sign(word, length);
+
+    if(sketching)
+        countSketch(word, length, sig);
+    else{
+
+        countExact(word, length, sig);
+
+        if(exactMemory() > budget)
+            startSketch();
+    }
+
+    if(++wordsSeen % every == 0)
+        snapshot();
+}
+
+/* Read fd to the end, a chunk at a time. A word cut by the end of a chunk is carried to the next one.*/
+void streamWords(int fd){
+
+    char     *chunk    = (char*)malloc(STREAM_CHUNK);
+    uint64_t used      = 0;         /* bytes of chunk in use: the carried word, then what was read.*/
+    uint64_t capacity  = STREAM_CHUNK;
+    ssize_t  got;
+
+    initSignature();
+    createHash(0);
+    text = NULL;
+
+    do{
+
+        uint64_t pos, end;
+
+        if(used == capacity){
+
+            capacity *= 2;
+            chunk     = (char*)realloc(chunk, capacity);
+        }
+
+        got = read(fd, chunk + used, capacity - used);
+
+        if(got < 0)
+            break;
+
+        used += got;
+        pos   = scanIn(chunk, used, 0, FALSE);
+
+        while(pos < used){
+
+            end = scanIn(chunk, used, pos, TRUE);
+
+            /* The word may go on in the next chunk, unless this was the end.*/
+            if(end == used AND got > 0)
+                break;
+
+            countWord(chunk + pos, (uint32_t)(end - pos));
+            pos = scanIn(chunk, used, end, FALSE);
+        }
+
+        memmove(chunk, chunk + pos, used - pos);
+        used -= pos;
+
+    }while(got > 0);
+
+    free(chunk);
+
+    if(wordsSeen % every != 0 || wordsSeen == 0)
+        snapshot();
+}
+
+/**********************************************************************************************************************************************/
+/*Updating the dictionary*/
+
+/*  With -u file the groups are updated one word at a time after they are built. Each line of the file is
+        +word   add the word,
+        -word   remove one copy of the word (the first one, with the same bytes),
+        ?       print the size of the greatest set right now,
+    and then the program goes on as usual with the updated dictionary.
+
+    The updates work on their own table D, filled from the groups that were built:
+    1) A removed signature leaves a DELETED_TAG in its slot, so the searches go on past it. Free and deleted slots both have
+       the high bit set, so one movemask finds them.
+    2) When the slots in use (with the deleted ones) would pass 7/8, a new table is made, twice as big if more than half of
+       them are live, or the same size to clear the deleted slots. The old table is not copied at once: every update moves
+       the next MIGRATE slots of it, and until it is empty a search looks in both.
+    3) The words of a group are a doubly linked list (by position in buffer, new words at the end) and the groups of each
+       size are another one, so the size of the greatest set is always known: it only changes by one, and when its list
+       gets empty the next smaller size is the greatest.*/
+
+#define DELETED_TAG 0xFE
+#define MIGRATE     64
+
+typedef struct{
+    unsigned char *ctrl;
+    Signature *key;
+    int *group;
+    uint64_t capacity;
+    uint64_t blockMask;
+    uint64_t next;          /* the next slot to move.*/
+}OldTable;
+
+Hash     D;
+OldTable old;
+uint64_t used           = 0;        /* slots of D.ctrl that are not EMPTY_TAG.*/
+int      liveGroups     = 0;
+int      *freeGroups    = NULL;     /* numbers of removed groups, to be used again.*/
+int      numFree        = 0;
+int      groupCapacity  = 0;
+int      *groupLast     = NULL;     /* the last word of each group (D.first is the first one).*/
+int      *sizeNext      = NULL;     /* the groups of each size, linked.*/
+int      *sizePrev      = NULL;
+int      *sizeHead      = NULL;     /* first group of each size, -1 if none.*/
+int      sizeCapacity   = 0;
+int      maxSize        = 0;
+int      *nextWord      = NULL;     /* the words of each group, linked.*/
+int      *prevWord      = NULL;
+int      wordCapacity   = 0;
+
+/* Bit i is set when ctrl[i] is free or deleted.*/
+static inline int matchFree(unsigned char *ctrl){
+
+#ifdef __SSE2__
+    return _mm_movemask_epi8(_mm_loadu_si128((__m128i*)ctrl));
+#else
+    int i, mask = 0;
+
+    for(i=0;i<BLOCK;i++)
+        mask |= (ctrl[i] >> 7) << i;
+
+    return mask;
+#endif
+}
+
+/* Slot of sig in a table (ctrl, key, group), or -1.*/
+int64_t probeTable(unsigned char *ctrl, Signature *key, int *group, uint64_t blockMask, Signature sig, uint64_t h, char *word, uint32_t length){
+
+    unsigned char tag   = h >> 57;
+    uint64_t      block = h & blockMask;
+    int           step  = 0;
+
+    while(TRUE){
+
+        int mask = matchTag(ctrl + block*BLOCK, tag);
+
+        while(mask){
+
+            uint64_t k = block*BLOCK + __builtin_ctz(mask);
+
+            if(key[k] == sig){
+
+                Word *w = &buffer[D.first[group[k]]];
+
+                if(!(sig & SPILLED) || sameBytes(text + w->offset, w->length, word, length))
+                    return (int64_t)k;
+            }
+
+            mask &= mask - 1;
+        }
+
+        if(matchTag(ctrl + block*BLOCK, EMPTY_TAG))
+            return -1;
+
+        ++step;
+        block = (block + step) & blockMask;
+    }
+}
+
+/* Put sig (of group g) in the first free or deleted slot of D along its probe sequence.*/
+void placeGroup(Signature sig, uint64_t h, int g){
+
+    uint64_t block = h & D.blockMask;
+    int      step  = 0;
+    int      mask;
+    uint64_t k;
+
+    while(!(mask = matchFree(D.ctrl + block*BLOCK))){
+
+        ++step;
+        block = (block + step) & D.blockMask;
+    }
+
+    k = block*BLOCK + __builtin_ctz(mask);
+
+    if(D.ctrl[k] == EMPTY_TAG)
+        ++used;
+
+    D.ctrl[k]  = h >> 57;
+    D.key[k]   = sig;
+    D.group[k] = g;
+}
+
+/* Move the next MIGRATE slots of the old table to D.*/
+void migrateStep(){
+
+    uint64_t end;
+
+    if(old.ctrl == NULL)
+        return;
+
+    end = old.next + MIGRATE < old.capacity ? old.next + MIGRATE : old.capacity;
+
+    /* The old slot becomes a tombstone, or a set removed from D later would still be found in the old table.*/
+    for(;old.next<end;old.next++)
+        if(!(old.ctrl[old.next] & 0x80)){
+
+            placeGroup(old.key[old.next], hashSignature(old.key[old.next]), old.group[old.next]);
+            old.ctrl[old.next] = DELETED_TAG;
+        }
+
+    if(old.next == old.capacity){
+
+        free(old.ctrl);
+        free(old.key);
+        free(old.group);
+        old.ctrl = NULL;
+    }
+}
+
+/* Make sure the arrays of the groups have room for the numbers up to capacity.*/
+void growGroups(int capacity){
+
+    if(capacity <= groupCapacity)
+        return;
+
+    groupLast     = (int*)realloc(groupLast, capacity*sizeof(int));
+    sizeNext      = (int*)realloc(sizeNext, capacity*sizeof(int));
+    sizePrev      = (int*)realloc(sizePrev, capacity*sizeof(int));
+    freeGroups    = (int*)realloc(freeGroups, capacity*sizeof(int));
+    groupCapacity = capacity;
+}
+
+/* Start moving D to a new table (2). The group numbers stay the same, so D.first and D.count are kept.*/
+void startGrowing(){
+
+    uint64_t capacity = ((uint64_t)liveGroups + 1 > D.capacity/2) ? 2*D.capacity : D.capacity;
+
+    /* Never happens with MIGRATE slots per update, but the old table must be empty before it is replaced.*/
+    while(old.ctrl != NULL)
+        migrateStep();
+
+    old.ctrl      = D.ctrl;
+    old.key       = D.key;
+    old.group     = D.group;
+    old.capacity  = D.capacity;
+    old.blockMask = D.blockMask;
+    old.next      = 0;
+
+    allocTable(&D, capacity);
+    growGroups((int)capacity);
+    used = 0;
+}
+
+/* Find the group of a word, in D or in the old table. *slot and *inOld say where its signature is.*/
+int findGroup(Signature sig, uint64_t h, char *word, uint32_t length, int64_t *slot, int *inOld){
+
+    *inOld = FALSE;
+    *slot  = probeTable(D.ctrl, D.key, D.group, D.blockMask, sig, h, word, length);
+
+    if(*slot >= 0)
+        return D.group[*slot];
+
+    if(old.ctrl != NULL){
+
+        *inOld = TRUE;
+        *slot  = probeTable(old.ctrl, old.key, old.group, old.blockMask, sig, h, word, length);
+
+        if(*slot >= 0)
+            return old.group[*slot];
+    }
+
+    return -1;
+}
+
+/* Move group g from the list of its size to the list of size + delta (3).*/
+void changeSize(int g, int delta){
+
+    int count = D.count[g];
+
+    if(count > 0){
+
+        if(sizePrev[g] >= 0)
+            sizeNext[sizePrev[g]] = sizeNext[g];
+        else
+            sizeHead[count] = sizeNext[g];
+
+        if(sizeNext[g] >= 0)
+            sizePrev[sizeNext[g]] = sizePrev[g];
+    }
+
+    count     += delta;
+    D.count[g] = count;
+
+    if(count > 0){
+
+        if(count >= sizeCapacity){
+
+            int s;
+
+            sizeHead = (int*)realloc(sizeHead, 2*(count + 1)*sizeof(int));
+
+            for(s=sizeCapacity;s<2*(count + 1);s++)
+                sizeHead[s] = -1;
+
+            sizeCapacity = 2*(count + 1);
+        }
+
+        sizePrev[g] = -1;
+        sizeNext[g] = sizeHead[count];
+
+        if(sizeHead[count] >= 0)
+            sizePrev[sizeHead[count]] = g;
+
+        sizeHead[count] = g;
+    }
+
+    if(maxSize < count)
+        maxSize = count;
+
+    while(maxSize > 0 AND sizeHead[maxSize] < 0)
+        --maxSize;
+}
+
+/* Put a word at the end of text and buffer. Returns its position.*/
+int appendWord(char *word, uint32_t length){
+
+    if(textSize + length > textCapacity){
+
+        textCapacity = 2*(textSize + length);
+        text         = (char*)realloc(text, textCapacity);
+    }
+
+    if(size + 1 > wordCapacity){
+
+        wordCapacity = 2*wordCapacity + 1024;
+        buffer       = (Word*)realloc(buffer, wordCapacity*sizeof(Word));
+        nextWord     = (int*)realloc(nextWord, wordCapacity*sizeof(int));
+        prevWord     = (int*)realloc(prevWord, wordCapacity*sizeof(int));
+    }
+
+    memcpy(text + textSize, word, length);
+    buffer[size].offset = textSize;
+    buffer[size].length = length;
+    textSize           += length;
+
+    return size++;
+}
+
+void addWord(char *word, uint32_t length){
+
+    Signature sig = sign(word, length);
+    uint64_t  h   = hashSignature(sig);
+    int64_t   slot;
+    int       inOld, g, p;
+
+    migrateStep();
+
+    g = findGroup(sig, h, word, length, &slot, &inOld);
+    p = appendWord(word, length);
+
+    nextWord[p] = -1;
+
+    if(g < 0){
+
+        if(used + 1 > D.capacity - D.capacity/8)
+            startGrowing();
+
+        g = (numFree > 0) ? freeGroups[--numFree] : D.numGroups++;
+
+        placeGroup(sig, h, g);
+        ++liveGroups;
+
+        D.first[g]   = p;
+        D.count[g]   = 0;
+        prevWord[p]  = -1;
+    }else{
+
+        prevWord[p]              = groupLast[g];
+        nextWord[groupLast[g]]   = p;
+    }
+
+    groupLast[g] = p;
+    changeSize(g, +1);
+}
+
+void removeWord(char *word, uint32_t length){
+
+    Signature sig = sign(word, length);
+    uint64_t  h   = hashSignature(sig);
+    int64_t   slot;
+    int       inOld, g, p;
+
+    migrateStep();
+
+    g = findGroup(sig, h, word, length, &slot, &inOld);
+
+    /* The first copy of the word in its group.*/
+    for(p = (g < 0) ? -1 : D.first[g]; p >= 0; p = nextWord[p])
+        if(buffer[p].length == length AND memcmp(text + buffer[p].offset, word, length) == 0)
+            break;
+
+    if(p < 0){
+
+        printf("%.*s is not in the dictionary\n", (int)length, word);
+        return;
+    }
+
+    if(prevWord[p] >= 0)
+        nextWord[prevWord[p]] = nextWord[p];
+    else
+        D.first[g] = nextWord[p];
+
+    if(nextWord[p] >= 0)
+        prevWord[nextWord[p]] = prevWord[p];
+    else
+        groupLast[g] = prevWord[p];
+
+    changeSize(g, -1);
+
+    /* The group is empty: free its slot and its number.*/
+    if(D.count[g] == 0){
+
+        if(inOld)
+            old.ctrl[slot] = DELETED_TAG;
+        else
+            D.ctrl[slot] = DELETED_TAG;
+
+        freeGroups[numFree++] = g;
+        --liveGroups;
+    }
+}
+
+/* Fill D from the groups that were built, with the same numbers, and the lists of words and sizes.*/
+void startUpdates(){
+
+    char     *copy;
+    uint64_t capacity = BLOCK;
+    int      g, i;
+
+    while(capacity - capacity/8 < (uint64_t)numGroups + 1)
+        capacity *= 2;
+
+    /* New words go at the end of text, so it stops being the mapped file.*/
+    textCapacity = textSize + STREAM_CHUNK;
+    copy         = (char*)malloc(textCapacity);
+
+    if(textSize > 0){
+
+        memcpy(copy, text, textSize);
+        munmap(text, textSize);
+    }
+
+    text         = copy;
+    wordCapacity = size + 1024;
+    buffer       = (Word*)realloc(buffer, wordCapacity*sizeof(Word));
+    nextWord     = (int*)malloc(wordCapacity*sizeof(int));
+    prevWord     = (int*)malloc(wordCapacity*sizeof(int));
+
+    initSignature();
+    memset(&D, 0, sizeof(Hash));
+    allocTable(&D, capacity);
+    growGroups((int)capacity);
+
+    D.numGroups = numGroups;
+    liveGroups  = numGroups;
+
+    for(g=0;g<numGroups;g++){
+
+        int  begin = groupStart[g];
+        int  end   = groupStart[g + 1];
+        Word *w    = &buffer[members[begin]];
+        Signature sig = sign(text + w->offset, w->length);
+
+        placeGroup(sig, hashSignature(sig), g);
+
+        D.first[g]   = members[begin];
+        groupLast[g] = members[end - 1];
+        D.count[g]   = 0;
+
+        for(i=begin;i<end;i++){
+
+            prevWord[members[i]] = (i > begin) ? members[i - 1] : -1;
+            nextWord[members[i]] = (i + 1 < end) ? members[i + 1] : -1;
+        }
+
+        changeSize(g, end - begin);
+    }
+
+    tables    = &D;
+    numTables = 1;
+}
+
+int compareFirst(const void *a, const void *b){
+
+    return D.first[*(const int*)a] - D.first[*(const int*)b];
+}
+
+/* Back to the CSR arrays, with the groups numbered again in order of first appearance, for the rest of the program.*/
+void flattenGroups(){
+
+    int *live = (int*)malloc((liveGroups + 1)*sizeof(int));
+    int g, n = 0, p, k = 0;
+
+    for(g=0;g<D.numGroups;g++)
+        if(D.count[g] > 0)
+            live[n++] = g;
+
+    qsort(live, n, sizeof(int), compareFirst);
+
+    groupStart = (int*)realloc(groupStart, (n + 2)*sizeof(int));
+    members    = (int*)realloc(members, (size + 1)*sizeof(int));
+
+    for(g=0;g<n;g++){
+
+        groupStart[g] = k;
+
+        for(p=D.first[live[g]];p>=0;p=nextWord[p])
+            members[k++] = p;
+    }
+
+    groupStart[n] = k;
+    numGroups     = n;
+    greaterSet    = maxSize;
+
+    free(live);
+}
+
+/* Apply the updates of the file, one line at a time.*/
+void applyUpdates(FILE *fp){
+
+    char    *line     = NULL;
+    size_t  capacity  = 0;
+    ssize_t length;
+
+    startUpdates();
+
+    while((length = getline(&line, &capacity, fp)) > 0){
+
+        ssize_t begin = 0, end;
+        char    op;
+
+        if(!nextToken(line, length, &begin, &end))
+            continue;
+
+        op = line[begin++];
+
+        if(op == '?'){
+
+            printf("Greatest set: %d words\n", maxSize);
+            continue;
+        }
+
+        /* The word may follow the + or - with or without blanks.*/
+        if(!nextToken(line, length, &begin, &end))
+            continue;
+
+        if(op == '+')
+            addWord(line + begin, (uint32_t)(end - begin));
+        else if(op == '-')
+            removeWord(line + begin, (uint32_t)(end - begin));
+    }
+
+    free(line);
+    flattenGroups();
+}
+
+/* Print the greatest set of anagram.*/
+void printGreatestSet(){
+
+    int g,j;
+    int cont    = 1;
+
+    for(g=0;g<numGroups;g++){
+
+        if(groupStart[g + 1] - groupStart[g] == greaterSet){
+
+            printf("\n\n%d - Set of anagrams :\n", cont++);
+
+            for(j=0;j<greaterSet;j++){
+
+                int position = members[groupStart[g] + j];
+                printf("%d: %.*s\n", j+1, (int)buffer[position].length, text + buffer[position].offset);
+            }
+        }
+    }
+
+}
+
+void printStats(){
+
+    ProbeStats all;
+    uint64_t   capacity = 0;
+    int        t;
+
+    memset(&all, 0, sizeof(ProbeStats));
+
+    for(t=0;t<numTables;t++){
+
+        capacity      += tables[t].capacity;
+        all.lookups   += tables[t].stats.lookups;
+        all.blocks    += tables[t].stats.blocks;
+        all.falseTags += tables[t].stats.falseTags;
+
+        if(all.longest < tables[t].stats.longest)
+            all.longest = tables[t].stats.longest;
+    }
+
+    if(numTables == 0){
+
+        printf("\n\nRadix sort: %d words, %d groups, %d of %d digit passes\n", size, numGroups, sortPasses, DIGITS);
+        return;
+    }
+
+    printf("\n\nHash table: %d words, %d groups, %d table(s) with %" PRIu64 " slots (%.1f%% full)\n",
+           size, numGroups, numTables, capacity, capacity ? 100.0*numGroups/capacity : 0.0);
+    printf("Probes: %.3f blocks per lookup, longest %d, %" PRIu64 " tags matched another signature\n",
+           all.lookups ? (double)all.blocks/all.lookups : 0.0, all.longest, all.falseTags);
+}
+
+/**********************************************************************************************************************************************/
+/*Report and benchmark*/
+
+/*  -json prints one line of JSON at the end:
+
+        {"engine":..,"threads":..,"words":..,"groups":..,"greatest":..,"load_s":..,"sign_s":..,"group_s":..,"layout_s":..,
+         "total_s":..,"words_per_s":..,"tables":..,"slots":..,"load_factor":..,"lookups":..,"probe_histogram":[..],
+         "tag_collisions":..,"signature_collisions":..,"sort_passes":..,"mapped_bytes":..,"heap_bytes":..,"peak_rss_kb":..}
+
+    probe_histogram[i] is the number of lookups that visited i + 1 blocks (the last one: 17 or more). tag_collisions are tags
+    that matched another signature, signature_collisions are SPILLED signatures of words with other letters. With -t the
+    signing is timed on thread 0 and group_s is the rest of the pipeline (tokenizing and layout included). heap_bytes is what
+    malloc holds at the end (glibc only, 0 elsewhere). -B is -json without printing the sets.
+
+    -gen N file writes a synthetic corpus: N words of the dictionary with their letters shuffled (seeded with -seed S), so
+    the sets are big. The benchmark is a mode of the program, each run in its own process, for example:
+
+        for n in 1000000 10000000 100000000; do
+            ./project2 dictionary.txt -gen $n corpus$n.txt
+            for e in hash sort; do ./project2 corpus$n.txt -e $e -B; done
+            ./project2 corpus$n.txt -t 0 -B
+        done*/
+
+uint64_t seed = 1;
+
+/* splitmix64.*/
+uint64_t nextRandom(){
+
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+void generateCorpus(uint64_t count, char *fileName){
+
+    FILE     *fp = fopen(fileName, "w");
+    char     *word = NULL;
+    uint32_t capacity = 0;
+    uint64_t n;
+
+    if(fp == NULL || size == 0){
+
+        printf("Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    for(n=0;n<count;n++){
+
+        Word     *w = &buffer[nextRandom() % size];
+        uint32_t i;
+
+        if(w->length + 1 > capacity){
+
+            capacity = 2*(w->length + 1);
+            word     = (char*)realloc(word, capacity);
+        }
+
+        memcpy(word, text + w->offset, w->length);
+
+        /* Fisher-Yates.*/
+        for(i=w->length;i>1;i--){
+
+            uint32_t j = nextRandom() % i;
+            char     c = word[i - 1];
+
+            word[i - 1] = word[j];
+            word[j]     = c;
+        }
+
+        word[w->length] = '\n';
+        fwrite(word, 1, w->length + 1, fp);
+    }
+
+    free(word);
+    fclose(fp);
+}
+
+void report(int engine){
+
+    struct rusage usage;
+    ProbeStats    all;
+    uint64_t      capacity = 0;
+    uint64_t      heap     = 0;
+    double        total    = now() - startTime;
+    int           t, b;
+
+    memset(&all, 0, sizeof(ProbeStats));
+
+    for(t=0;t<numTables;t++){
+
+        capacity       += tables[t].capacity;
+        all.lookups    += tables[t].stats.lookups;
+        all.falseTags  += tables[t].stats.falseTags;
+        all.collisions += tables[t].stats.collisions;
+
+        for(b=0;b<PROBE_BUCKETS;b++)
+            all.histogram[b] += tables[t].stats.histogram[b];
+    }
+
+#if defined(__GLIBC__) AND (__GLIBC__ > 2 || (__GLIBC__ == 2 AND __GLIBC_MINOR__ >= 33))
+    {
+        struct mallinfo2 info = mallinfo2();
+        heap = info.uordblks + info.hblkhd;
+    }
+#endif
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"engine\":\"%s\",\"threads\":%d,\"words\":%d,\"groups\":%d,\"greatest\":%d,", engine == SORT ? "sort" : "hash",
+           engine == SORT ? 1 : numThreads, size, numGroups, greaterSet);
+    printf("\"load_s\":%f,\"sign_s\":%f,\"group_s\":%f,\"layout_s\":%f,\"total_s\":%f,\"words_per_s\":%.0f,",
+           loadTime, signTime, groupTime, layoutTime, total, total > 0 ? size/total : 0.0);
+    printf("\"tables\":%d,\"slots\":%" PRIu64 ",\"load_factor\":%f,\"lookups\":%" PRIu64 ",\"probe_histogram\":[",
+           numTables, capacity, capacity ? (double)numGroups/capacity : 0.0, all.lookups);
+
+    for(b=0;b<PROBE_BUCKETS;b++)
+        printf("%s%" PRIu64, b ? "," : "", all.histogram[b]);
+
+    printf("],\"tag_collisions\":%" PRIu64 ",\"signature_collisions\":%" PRIu64 ",\"sort_passes\":%d,", all.falseTags, all.collisions, sortPasses);
+    printf("\"mapped_bytes\":%" PRIu64 ",\"heap_bytes\":%" PRIu64 ",\"peak_rss_kb\":%ld}\n", textSize, heap, usage.ru_maxrss);
+}
+
+char nameFile[30];
+
+int main(int argc, char *argv[]){
+
+    char *fileName  = NULL;
+    int  showStats  = FALSE;
+    int  engine     = HASH;
+    char *saveFile  = NULL;
+    char *loadFile  = NULL;
+    char *queryFile = NULL;
+    char *rackFile  = NULL;
+    char *updates   = NULL;
+    int  stream     = FALSE;
+    int  benchmark  = FALSE;
+    char *corpus    = NULL;
+    uint64_t corpusWords = 0;
+    int  parallel;
+    int  i;
+
+    startTime = now();
+
+    for(i=1;i<argc;i++){
+
+        if(strcmp(argv[i], "-stats") == 0)
+            showStats = TRUE;
+        else if(strcmp(argv[i], "-json") == 0)
+            instrument = TRUE;
+        else if(strcmp(argv[i], "-B") == 0)
+            instrument = benchmark = TRUE;
+        else if(strcmp(argv[i], "-seed") == 0 AND i + 1 < argc)
+            seed = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-gen") == 0 AND i + 2 < argc){
+
+            corpusWords = strtoull(argv[++i], NULL, 10);
+            corpus      = argv[++i];
+        }
+        else if(strcmp(argv[i], "-save") == 0 AND i + 1 < argc)
+            saveFile = argv[++i];
+        else if(strcmp(argv[i], "-load") == 0 AND i + 1 < argc)
+            loadFile = argv[++i];
+        else if(strcmp(argv[i], "-stream") == 0)
+            stream = TRUE;
+        else if(strcmp(argv[i], "-k") == 0 AND i + 1 < argc)
+            topK = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-m") == 0 AND i + 1 < argc)
+            budget = (uint64_t)atoll(argv[++i]) << 20;
+        else if(strcmp(argv[i], "-every") == 0 AND i + 1 < argc)
+            every = strtoull(argv[++i], NULL, 10);
+        else if(strcmp(argv[i], "-u") == 0 AND i + 1 < argc)
+            updates = argv[++i];
+        else if(strcmp(argv[i], "-r") == 0 AND i + 1 < argc)
+            rackFile = argv[++i];
+        else if(strcmp(argv[i], "-q") == 0 AND i + 1 < argc)
+            queryFile = argv[++i];
+        else if(strcmp(argv[i], "-t") == 0 AND i + 1 < argc)
+            numThreads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-e") == 0 AND i + 1 < argc){
+
+            ++i;
+
+            if(strcmp(argv[i], "sort") == 0)
+                engine = SORT;
+            else if(strcmp(argv[i], "hash") == 0)
+                engine = HASH;
+            else{
+
+                printf("Unknown engine %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else
+            fileName = argv[i];
+    }
+
+    /* With an index there is no dictionary to read: just answer the queries.*/
+    if(loadFile != NULL){
+
+        FILE *fp = (queryFile != NULL) ? fopen(queryFile, "r") : stdin;
+
+        if(fp == NULL){
+
+            printf("Could not open %s\n", queryFile);
+            return 1;
+        }
+
+        loadIndex(loadFile);
+        answerQueries(fp);
+
+        return 0;
+    }
+
+    /* A stream is read as it comes, from the file or from the standard input.*/
+    if(stream){
+
+        int fd = (fileName != NULL) ? open(fileName, O_RDONLY) : 0;
+
+        if(fd < 0){
+
+            printf("Could not open %s\n", fileName);
+            return 1;
+        }
+
+        if(every == 0)
+            every = UINT64_MAX;
+
+        streamWords(fd);
+
+        return 0;
+    }
+
+    if(fileName == NULL){
+
+        printf("Write the name of the file: ");
+
+        if(scanf("%29s",nameFile) != 1)
+            return 1;
+
+        fileName = nameFile;
+    }
+
+    /* -t 0 becomes the number of processors here, so every branch below sees the same number of threads.*/
+    if(numThreads <= 0)
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(numThreads <= 0)
+        numThreads = 1;
+
+    parallel = engine != SORT AND numThreads != 1;
+
+    loadTime = now();
+
+    readFile(fileName);
+
+    /* The parallel version finds the words itself.*/
+    if(corpus != NULL || !parallel)
+        splitWords();
+
+    loadTime = now() - loadTime;
+
+    if(corpus != NULL){
+
+        generateCorpus(corpusWords, corpus);
+        return 0;
+    }
+
+    if(engine == SORT)
+        sortGroups();
+    else if(parallel)
+        parallelGroups();
+    else{
+
+        createHash(size);
+
+        populateHash();
+    }
+
+    if(!parallel){
+
+        layoutTime = now();
+        layoutGroups();
+        layoutTime = now() - layoutTime;
+    }
+
+    if(updates != NULL){
+
+        FILE *fp = fopen(updates, "r");
+
+        if(fp == NULL){
+
+            printf("Could not open %s\n", updates);
+            return 1;
+        }
+
+        applyUpdates(fp);
+        fclose(fp);
+    }
+
+    if(rackFile != NULL){
+
+        FILE *fp = fopen(rackFile, "r");
+
+        if(fp == NULL){
+
+            printf("Could not open %s\n", rackFile);
+            return 1;
+        }
 
-    readFile(nameFile);
+        answerRacks(fp);
+        fclose(fp);
+    }else if(!benchmark)
+        printGreatestSet();
 
-    createHash(size);
+    if(saveFile != NULL)
+        saveIndex(saveFile);
 
-    populateHash();
+    if(showStats)
+        printStats();
 
-    printGreatestSet();
+    if(instrument)
+        report(engine);
 
     return 0;
 }
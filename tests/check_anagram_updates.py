@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Check the incremental updates of project2 (-u) against a simple model in Python.
+
+Each round makes a random dictionary and a random update file (+word, -word and ?),
+including whole sets that are removed and added back while the table is migrating
+to a bigger one, and compares the output of
+    project2 dictionary.txt -u updates.txt
+with the expected answers to ? and the expected greatest sets at the end.
+The first round is a fixed case: a set removed and added back right after the
+table starts growing.
+
+    gcc -O2 -pthread project2.c -o project2
+    python3 tests/check_anagram_updates.py ./project2 [rounds] [seed]
+"""
+import itertools, os, random, subprocess, sys, tempfile
+
+def key(word):
+    return ''.join(sorted(word.lower()))
+
+class Model:
+    """The words in order of insertion, and the number of live words of each signature."""
+
+    def __init__(self, words):
+        self.words, self.alive, self.where, self.size = [], [], {}, {}
+        for w in words:
+            self.add(w)
+
+    def add(self, w):
+        self.where.setdefault(w, []).append(len(self.words))
+        self.words.append(w)
+        self.alive.append(True)
+        self.size[key(w)] = self.size.get(key(w), 0) + 1
+
+    def remove(self, w):
+        """Removes the oldest live copy of w. Returns False if there is none."""
+        if not self.where.get(w):
+            return False
+        self.alive[self.where[w].pop(0)] = False
+        self.size[key(w)] -= 1
+        return True
+
+    def greatest(self):
+        return max(self.size.values(), default=0)
+
+    def final(self):
+        groups = {}
+        for w, a in zip(self.words, self.alive):
+            if a:
+                groups.setdefault(key(w), []).append(w)
+        g = max((len(v) for v in groups.values()), default=0)
+        lines = []
+        for number, members in enumerate((v for v in groups.values() if len(v) == g), 1):
+            lines += ['', '', '%d - Set of anagrams :' % number]
+            lines += ['%d: %s' % (j, w) for j, w in enumerate(members, 1)]
+        return lines
+
+def expected(words, updates):
+    model, out = Model(words), []
+    for u in updates:
+        if u == '?':
+            out.append('Greatest set: %d words' % model.greatest())
+        elif u[0] == '+':
+            model.add(u[1:])
+        elif not model.remove(u[1:]):
+            out.append('%s is not in the dictionary' % u[1:])
+    return out + model.final()
+
+def random_case():
+    alphabet = random.choice(('abcde', 'aBc1.', 'abcdefghijklmnopqrst'))
+    def word():
+        return ''.join(random.choice(alphabet) for _ in range(random.randint(1, 4)))
+    words = [word() for _ in range(random.choice((0, 1, 50, 500, 1500)))]
+    model, updates = Model(words), []
+    for _ in range(random.randint(0, 3000)):
+        r = random.random()
+        live = [w for w, a in zip(model.words, model.alive) if a] if r < 0.9 else []
+        if r < 0.05 and live:
+            # a whole set goes away and comes back, maybe while the table is migrating
+            k = key(random.choice(live))
+            members = [w for w in live if key(w) == k]
+            updates += ['-' + w for w in members] + ['?'] + ['+' + w for w in members]
+            for w in members:
+                model.remove(w)
+            for w in members:
+                model.add(w)
+        elif r < 0.45:
+            w = word()
+            updates.append('+' + w)
+            model.add(w)
+        elif r < 0.9 and live and random.random() < 0.9:
+            w = random.choice(live)
+            updates.append('-' + w)
+            model.remove(w)
+        elif r < 0.9:
+            updates.append('-zz' + word())
+        else:
+            updates.append('?')
+    return words, updates
+
+def migration_case():
+    words = [''.join(t) for t in itertools.islice(itertools.combinations('defghijklmnopq', 4), 888)]
+    words += ['abc', 'bca', 'cab']
+    updates = ['+x%sy' % ''.join(t) for t in itertools.islice(itertools.product('qrstuvw', repeat=2), 16)]
+    updates += '-abc -bca -cab ? +abc +bca +cab ?'.split()
+    return words, updates
+
+def main():
+    binary = os.path.abspath(sys.argv[1])
+    rounds = int(sys.argv[2]) if len(sys.argv) > 2 else 100
+    random.seed(int(sys.argv[3]) if len(sys.argv) > 3 else 1)
+    work = tempfile.mkdtemp()
+    dictionary, updateFile = os.path.join(work, 'dictionary.txt'), os.path.join(work, 'updates.txt')
+
+    for r in range(rounds):
+        words, updates = migration_case() if r == 0 else random_case()
+        with open(dictionary, 'w') as f:
+            f.write(''.join(w + '\n' for w in words))
+        with open(updateFile, 'w') as f:
+            f.write(''.join(u + '\n' for u in updates))
+
+        result = subprocess.run([binary, dictionary, '-u', updateFile], capture_output=True, text=True)
+        if result.returncode != 0 or result.stdout.rstrip('\n').split('\n') != expected(words, updates):
+            sys.exit('round %d differs, see %s' % (r, work))
+
+    print('OK: %d rounds' % rounds)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Check the incremental updates of project1 (-u) against a full rebuild.
+
+Each round makes a random maze and a random list of toggles, then compares
+    project1 -u toggles.txt -q all-grids.txt        (repairs the distances)
+    project1 -q all-grids.txt                        (on the maze with the toggles applied)
+and the same with -l on a saved field. The distances and numbers of paths of
+every grid must be the same.
+
+    gcc -O2 -pthread project1.c -o project1
+    python3 tests/check_maze_updates.py ./project1 [rounds] [seed]
+"""
+import os, random, subprocess, sys, tempfile
+
+def write_maze(path, n, m, thomas, exits, walls):
+    with open(path, 'w') as f:
+        f.write('%d %d\n' % thomas)
+        f.write(' '.join('%d %d' % e for e in exits) + '\n')
+        f.write('%d %d\n' % (n, m))
+        for x in range(n):
+            f.write(' '.join('1' if (x, y) in walls else '0' for y in range(m)) + '\n')
+
+def run(binary, args, cwd):
+    r = subprocess.run([binary] + args, cwd=cwd, capture_output=True, text=True)
+    if r.returncode != 0:
+        sys.exit('%s %s failed:\n%s%s' % (binary, ' '.join(args), r.stdout, r.stderr))
+    return r.stdout
+
+def main():
+    binary = os.path.abspath(sys.argv[1])
+    rounds = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+    random.seed(int(sys.argv[3]) if len(sys.argv) > 3 else 1)
+    work = tempfile.mkdtemp()
+
+    for r in range(rounds):
+        n, m = random.randint(1, 14), random.randint(1, 70)
+        cells = [(x, y) for x in range(n) for y in range(m)]
+        thomas = random.choice(cells)
+        exits = random.sample(cells, min(len(cells), random.randint(1, 3)))
+        fixed = set(exits) | {thomas}
+        free = [c for c in cells if c not in fixed]
+        walls = {c for c in free if random.random() < random.choice((0.1, 0.3, 0.5))}
+        toggles = [random.choice(free) for _ in range(random.randint(0, 40))] if free else []
+
+        write_maze(os.path.join(work, 'maze.txt'), n, m, thomas, exits, walls)
+        with open(os.path.join(work, 'toggles.txt'), 'w') as f:
+            f.write(''.join('%d %d\n' % c for c in toggles))
+        with open(os.path.join(work, 'grids.txt'), 'w') as f:
+            f.write(''.join('%d %d\n' % c for c in cells))
+
+        repaired = run(binary, ['-u', 'toggles.txt', '-q', 'grids.txt', '-k', '4'], work)
+        run(binary, ['-s', 'field.bin', '-c'], work)
+        mapped = run(binary, ['-l', 'field.bin', '-u', 'toggles.txt', '-q', 'grids.txt', '-k', '4'], work)
+
+        for c in toggles:
+            walls ^= {c}
+        write_maze(os.path.join(work, 'maze.txt'), n, m, thomas, exits, walls)
+        rebuilt = run(binary, ['-q', 'grids.txt', '-k', '4'], work)
+
+        if repaired != rebuilt or mapped != rebuilt:
+            sys.exit('round %d differs, see %s' % (r, work))
+
+    print('OK: %d rounds' % rounds)
+
+if __name__ == '__main__':
+    main()